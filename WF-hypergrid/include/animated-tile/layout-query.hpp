@@ -0,0 +1,92 @@
+/*
+ * Animated Tiling - layout query API for other plugins
+ *
+ * The animated-tile plugin publishes, per output, where every tiled view
+ * is going (its goal geometry, not the mid-animation one). Consumers such
+ * as expo, scale or status widgets read it in place:
+ *
+ *   auto query = output->get_data<animated_tile::layout_query_t>();
+ *   if (auto zones = query ? query->get_zones(ws) : nullptr)
+ *   {
+ *       for (auto layout : *zones)
+ *           if (layout->generation != my_cached_generation)
+ *               for (auto& tile : layout->tiles) ...
+ *   }
+ *
+ * Every workspace has one layout per zone, left to right; without the
+ * zones option that is a single layout covering the whole workspace.
+ * On outputs spanned into one surface (span_outputs) all members share
+ * the layouts, and goals are in that surface's coordinates.
+ *
+ * All data is owned by animated-tile and must be treated as read-only.
+ * It stays valid until the next layout change; layout_changed_signal is
+ * emitted on the output after a zone's layout changed.
+ */
+
+#pragma once
+
+#include <wayfire/object.hpp>
+#include <wayfire/geometry.hpp>
+#include <wayfire/toplevel-view.hpp>
+
+#include <map>
+#include <vector>
+#include <cstdint>
+
+#define ANIMATED_TILE_LAYOUT_QUERY_VERSION 1
+
+namespace animated_tile
+{
+
+// One tiled view and the geometry the layout is taking it to
+struct tile_goal_t
+{
+    wf::toplevel_view_interface_t *view;
+    wf::geometry_t goal;
+    bool visible;  // False for background tabs and tiles hidden by monocle
+
+    bool operator==(const tile_goal_t& o) const
+    {
+        return view == o.view && goal == o.goal && visible == o.visible;
+    }
+
+    bool operator!=(const tile_goal_t& o) const { return !(*this == o); }
+};
+
+// Goal geometry of every tiled view of one workspace zone, in tree order,
+// in output-local coordinates of that workspace
+struct workspace_layout_t
+{
+    std::vector<tile_goal_t> tiles;
+
+    // Bumped whenever any entry of `tiles` changes; consumers can skip
+    // work while it stays the same
+    uint64_t generation = 0;
+};
+
+// Stored on each output the plugin runs on
+class layout_query_t : public wf::custom_data_t
+{
+  public:
+    // Zone layouts, left to right, by workspace index (y * grid width + x);
+    // only workspaces and zones that ever had a tiled view are present
+    std::map<int, std::vector<const workspace_layout_t*>> workspaces;
+    int grid_width = 1;
+
+    const std::vector<const workspace_layout_t*>* get_zones(wf::point_t workspace) const
+    {
+        auto it = workspaces.find(workspace.y * grid_width + workspace.x);
+        return (it != workspaces.end()) ? &it->second : nullptr;
+    }
+};
+
+// Emitted on the output after the layout of a workspace zone changed
+struct layout_changed_signal
+{
+    wf::output_t *output;
+    wf::point_t workspace;
+    int zone;
+    const workspace_layout_t *layout;
+};
+
+} // namespace animated_tile
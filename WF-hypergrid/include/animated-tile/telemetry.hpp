@@ -0,0 +1,67 @@
+/*
+ * Animated Tiling - shared-memory telemetry
+ *
+ * Every output the plugin runs on publishes live counters in
+ * $XDG_RUNTIME_DIR/animated-tile-<output>.telemetry, a file holding one
+ * telemetry_t, updated once per second. Monitoring tools map it
+ * read-only and sample it at any rate without involving the compositor.
+ * It is a seqlock: retry while the sequence is odd or changed during the
+ * copy.
+ *
+ *   auto t = static_cast<const animated_tile::telemetry_t*>(
+ *       mmap(nullptr, sizeof(telemetry_t), PROT_READ, MAP_SHARED, fd, 0));
+ *   animated_tile::telemetry_data_t snapshot;
+ *   uint32_t seq;
+ *   do {
+ *       seq = t->sequence.load(std::memory_order_acquire);
+ *       snapshot = t->data;
+ *       std::atomic_thread_fence(std::memory_order_acquire);
+ *   } while ((seq & 1) || seq != t->sequence.load(std::memory_order_relaxed));
+ *
+ * Check magic and version before reading; the file is removed when the
+ * output goes away or the plugin is unloaded. A new plugin instance
+ * creates a new file rather than reusing the old one, so reopen the path
+ * when update_time_ns stops advancing.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace animated_tile
+{
+
+constexpr uint32_t TELEMETRY_MAGIC = 0x4d4c5441;  // "ATLM"
+constexpr uint32_t TELEMETRY_VERSION = 1;
+constexpr int TELEMETRY_MAX_WORKSPACES = 64;
+
+struct telemetry_data_t
+{
+    uint64_t update_time_ns;          // CLOCK_MONOTONIC of the last update
+    uint32_t active_animations;       // Tiles with a running transition
+    uint32_t configures_per_second;   // Resizes sent to clients, last second
+    
+    // Plugin tick time over the frames of the last second, microseconds
+    uint32_t tick_us_p50;
+    uint32_t tick_us_p90;
+    uint32_t tick_us_p99;
+    uint32_t tick_us_max;
+    
+    // Tiled windows per workspace index (y * grid width + x)
+    uint32_t workspace_count;
+    uint32_t tree_sizes[TELEMETRY_MAX_WORKSPACES];
+};
+
+struct telemetry_t
+{
+    uint32_t magic;
+    uint32_t version;
+    std::atomic<uint32_t> sequence;   // Odd while an update is in progress
+    telemetry_data_t data;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+    "the sequence must be usable across processes");
+
+} // namespace animated_tile
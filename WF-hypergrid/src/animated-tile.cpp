@@ -5,7 +5,7 @@
  * Windows smoothly animate to their new positions when the layout changes.
  * 
  * Architecture:
- * - TileNode: Binary tree node representing window or split
+ * - TileNode: Tree node representing a window or an n-ary split container
  * - AnimatedGeometry: Manages smooth position/size transitions
  * - TileTree: Per-workspace layout tree
  * - AnimatedTilePlugin: Main plugin coordinating everything
@@ -43,15 +43,48 @@
 #include <wayfire/nonstd/wlroots-full.hpp>
 #include <wayfire/plugins/common/input-grab.hpp>
 #include <wayfire/seat.hpp>
+#include <wayfire/util.hpp>
+#include <wayfire/opengl.hpp>
+#include <wayfire/region.hpp>
+#include <wayfire/scene-render.hpp>
+#include <wayfire/plugins/common/shared-core-data.hpp>
+#include <wayfire/plugins/ipc/ipc-method-repository.hpp>
+
+#include <animated-tile/layout-query.hpp>
+#include <animated-tile/telemetry.hpp>
 
 #include <map>
+#include <array>
+#include <atomic>
+#include <new>
+#include <set>
+#include <list>
+#include <unordered_map>
 #include <memory>
 #include <vector>
 #include <string>
 #include <cmath>
+#include <cstdint>
+#include <climits>
 #include <chrono>
 #include <optional>
 #include <algorithm>
+#include <numeric>
+#include <fstream>
+#include <sstream>
+#include <cctype>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cerrno>
+#include <ctime>
+#include <functional>
+#include <utility>
+#include <iomanip>
+#include <sys/types.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 
 namespace animated_tile
 {
@@ -151,6 +184,15 @@ struct AnimationConfig
     }
 };
 
+// ============================================================================
+// Animation Clock
+// ============================================================================
+
+// steady_clock is CLOCK_MONOTONIC, the same clock wlroots uses for
+// presentation timestamps, so predicted display times can be fed directly
+// into the animation channels.
+using AnimClock = std::chrono::steady_clock;
+
 // ============================================================================
 // Animated Variable (like Hyprland's CAnimatedVariable)
 // ============================================================================
@@ -170,19 +212,27 @@ class AnimatedVar
     
     void set(T goal, bool animate = true)
     {
+        // Already resting at this goal - don't start an empty animation
+        if (animate && !m_animating && goal == m_goal && m_value == m_goal)
+            return;
+        
         if (!animate || m_durationMs <= 0)
         {
             m_value = goal;
             m_goal = goal;
             m_start = goal;
             m_animating = false;
+            m_scrubbing = false;
+            m_releaseMs = 0.0f;
             return;
         }
         
         m_start = m_value;
         m_goal = goal;
-        m_startTime = std::chrono::high_resolution_clock::now();
+        m_startTime = AnimClock::now();
         m_animating = true;
+        m_scrubbing = false;
+        m_releaseMs = 0.0f;
     }
     
     void warp(T value)
@@ -191,25 +241,69 @@ class AnimatedVar
         m_goal = value;
         m_start = value;
         m_animating = false;
+        m_scrubbing = false;
+        m_releaseMs = 0.0f;
+    }
+    
+    // Detach a running animation from the clock; progress then comes
+    // from an external source (e.g. a touchpad gesture) through scrub()
+    void beginScrub()
+    {
+        if (m_animating)
+            m_scrubbing = true;
+    }
+    
+    // Position the channel at the given fraction of start -> goal, 1:1
+    void scrub(float progress)
+    {
+        if (!m_scrubbing)
+            return;
+        m_value = lerp(m_start, m_goal, std::clamp(progress, 0.0f, 1.0f));
+    }
+    
+    // Hand a scrubbed (or running) channel back to the clock: finish the
+    // remaining distance to the goal over durationMs with a quadratic
+    // ease-out, whose initial slope matches the release velocity when the
+    // caller picks durationMs = 2 * remaining / velocity
+    void release(float durationMs)
+    {
+        if (!m_animating)
+            return;
+        
+        m_start = m_value;
+        m_startTime = AnimClock::now();
+        m_scrubbing = false;
+        m_releaseMs = std::max(durationMs, 1.0f);
     }
     
-    bool tick()
+    // Sample the channel at the given time (normally the predicted
+    // presentation time of the frame being built, not the current time)
+    bool tick(AnimClock::time_point now)
     {
         if (!m_animating)
             return false;
         
-        auto now = std::chrono::high_resolution_clock::now();
-        float elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        // Externally driven - hold the scrubbed value until released
+        if (m_scrubbing)
+            return true;
+        
+        float duration = (m_releaseMs > 0.0f) ? m_releaseMs : m_durationMs;
+        float elapsed = std::chrono::duration<float, std::milli>(
             now - m_startTime).count();
-        float progress = std::clamp(elapsed / m_durationMs, 0.0f, 1.0f);
+        float progress = std::clamp(elapsed / duration, 0.0f, 1.0f);
         
-        float eased = m_curve ? m_curve->getYForX(progress) : progress;
+        float eased;
+        if (m_releaseMs > 0.0f)
+            eased = 1.0f - (1.0f - progress) * (1.0f - progress);
+        else
+            eased = m_curve ? m_curve->getYForX(progress) : progress;
         m_value = lerp(m_start, m_goal, eased);
         
         if (progress >= 1.0f)
         {
             m_value = m_goal;
             m_animating = false;
+            m_releaseMs = 0.0f;
             return false;
         }
         
@@ -219,6 +313,7 @@ class AnimatedVar
     T value() const { return m_value; }
     T goal() const { return m_goal; }
     bool isAnimating() const { return m_animating; }
+    bool isScrubbing() const { return m_scrubbing; }
     
   private:
     T m_value{};
@@ -227,22 +322,65 @@ class AnimatedVar
     BezierCurve* m_curve = nullptr;
     float m_durationMs = 300.0f;
     bool m_animating = false;
-    std::chrono::time_point<std::chrono::high_resolution_clock> m_startTime;
+    bool m_scrubbing = false;
+    float m_releaseMs = 0.0f;  // > 0 while finishing a released scrub
+    AnimClock::time_point m_startTime;
     
     static float lerp(float a, float b, float t) { return a + (b - a) * t; }
-    static int lerp(int a, int b, float t) { return static_cast<int>(a + (b - a) * t); }
+    static int lerp(int a, int b, float t) { return static_cast<int>(std::lround(a + (b - a) * t)); }
+};
+
+// ============================================================================
+// Sub-pixel geometry - animated rectangles are kept in float and only
+// rounded once, to the output's physical pixel grid, when rendering
+// ============================================================================
+
+struct GeometryF
+{
+    float x = 0.0f;
+    float y = 0.0f;
+    float width = 0.0f;
+    float height = 0.0f;
+    
+    bool operator==(const GeometryF& other) const
+    {
+        return x == other.x && y == other.y &&
+               width == other.width && height == other.height;
+    }
+    
+    bool operator!=(const GeometryF& other) const { return !(*this == other); }
 };
 
+// Snap a logical rectangle to the physical pixel grid of an output with the
+// given scale. Edges are snapped (not position + size) so that neighbouring
+// tiles sharing an edge always land on the same physical pixel.
+inline GeometryF snapToPixelGrid(const GeometryF& geo, float outputScale)
+{
+    if (outputScale <= 0.0f)
+        outputScale = 1.0f;
+    
+    auto snap = [outputScale] (float v) {
+        return std::round(v * outputScale) / outputScale;
+    };
+    
+    float x1 = snap(geo.x);
+    float y1 = snap(geo.y);
+    float x2 = snap(geo.x + geo.width);
+    float y2 = snap(geo.y + geo.height);
+    return {x1, y1, x2 - x1, y2 - y1};
+}
+
 // ============================================================================
 // Animated Geometry - position and size with smooth transitions
 // ============================================================================
 
 struct AnimatedGeometry
 {
-    AnimatedVar<int> x{0};
-    AnimatedVar<int> y{0};
-    AnimatedVar<int> width{100};
-    AnimatedVar<int> height{100};
+    // Geometry channels animate in float; layout goals are still integral
+    AnimatedVar<float> x{0.0f};
+    AnimatedVar<float> y{0.0f};
+    AnimatedVar<float> width{100.0f};
+    AnimatedVar<float> height{100.0f};
     
     // For popin animation
     AnimatedVar<float> scale{1.0f};
@@ -290,25 +428,60 @@ struct AnimatedGeometry
         alpha.set(0.0f, true);
     }
     
-    bool tick()
+    void beginScrub()
+    {
+        x.beginScrub();
+        y.beginScrub();
+        width.beginScrub();
+        height.beginScrub();
+        scale.beginScrub();
+        alpha.beginScrub();
+    }
+    
+    void scrub(float progress)
+    {
+        x.scrub(progress);
+        y.scrub(progress);
+        width.scrub(progress);
+        height.scrub(progress);
+        scale.scrub(progress);
+        alpha.scrub(progress);
+    }
+    
+    void release(float durationMs)
     {
-        bool a = x.tick();
-        bool b = y.tick();
-        bool c = width.tick();
-        bool d = height.tick();
-        bool e = scale.tick();
-        bool f = alpha.tick();
+        x.release(durationMs);
+        y.release(durationMs);
+        width.release(durationMs);
+        height.release(durationMs);
+        scale.release(durationMs);
+        alpha.release(durationMs);
+    }
+    
+    bool tick(AnimClock::time_point now)
+    {
+        bool a = x.tick(now);
+        bool b = y.tick(now);
+        bool c = width.tick(now);
+        bool d = height.tick(now);
+        bool e = scale.tick(now);
+        bool f = alpha.tick(now);
         return a || b || c || d || e || f;
     }
     
-    wf::geometry_t current() const
+    GeometryF current() const
     {
         return {x.value(), y.value(), width.value(), height.value()};
     }
     
     wf::geometry_t goal() const
     {
-        return {x.goal(), y.goal(), width.goal(), height.goal()};
+        return {
+            static_cast<int>(std::lround(x.goal())),
+            static_cast<int>(std::lround(y.goal())),
+            static_cast<int>(std::lround(width.goal())),
+            static_cast<int>(std::lround(height.goal()))
+        };
     }
     
     bool isAnimating() const
@@ -318,6 +491,12 @@ struct AnimatedGeometry
                scale.isAnimating() || alpha.isAnimating();
     }
     
+    int animatingChannels() const
+    {
+        return x.isAnimating() + y.isAnimating() + width.isAnimating() +
+            height.isAnimating() + scale.isAnimating() + alpha.isAnimating();
+    }
+    
     float currentScale() const { return scale.value(); }
     float currentAlpha() const { return alpha.value(); }
 };
@@ -333,7 +512,25 @@ enum class SplitDir
 };
 
 // ============================================================================
-// Tile Node - Binary tree node for tiling layout
+// Layout Mode - how a tree maps its leaves onto the workspace
+// ============================================================================
+
+enum class LayoutMode
+{
+    DWINDLE,  // Regular split tree
+    MONOCLE,  // Focused leaf fills the workspace, other tiles hidden
+    GRID      // Leaves in tree order on a flat near-square grid
+};
+
+// Automatic layout selection: (minimum leaf count, mode), sorted by count
+using LayoutPolicy = std::vector<std::pair<int, LayoutMode>>;
+
+// ============================================================================
+// Tile Node - tree node for tiling layout
+//
+// Split nodes are i3-style containers: any number of children laid out in
+// one direction, each with a weight (its share of the container). A classic
+// dwindle split is simply a container with two children.
 // ============================================================================
 
 class TileNode;
@@ -349,43 +546,206 @@ class TileNode : public std::enable_shared_from_this<TileNode>
         auto node = std::make_shared<TileNode>();
         node->m_view = view;
         node->m_isLeaf = true;
+        touchInputs();
         return node;
     }
     
     static TileNodePtr createSplit(SplitDir dir, TileNodePtr left, TileNodePtr right)
+    {
+        return createContainer(dir, {left, right});
+    }
+    
+    // N-ary container with equal weights
+    static TileNodePtr createContainer(SplitDir dir, std::vector<TileNodePtr> children)
     {
         auto node = std::make_shared<TileNode>();
         node->m_isLeaf = false;
         node->m_splitDir = dir;
-        node->m_children[0] = left;
-        node->m_children[1] = right;
+        node->m_children = std::move(children);
+        node->m_weights.assign(node->m_children.size(),
+            1.0f / std::max<size_t>(1, node->m_children.size()));
         
-        if (left) left->m_parent = node;
-        if (right) right->m_parent = node;
+        for (auto& c : node->m_children)
+        {
+            if (c) c->m_parent = node;
+        }
         
+        touchInputs();
         return node;
     }
     
     bool isLeaf() const { return m_isLeaf; }
     wayfire_toplevel_view view() const { return m_view; }
+    
     void setView(wayfire_toplevel_view v) { m_view = v; }
+    
+    // Put `newView` where `oldView` is, whether active or a background tab
+    void replaceTab(wayfire_toplevel_view oldView, wayfire_toplevel_view newView)
+    {
+        std::replace(m_tabs.begin(), m_tabs.end(), oldView, newView);
+        if (m_view == oldView)
+            m_view = newView;
+    }
+    
+    // Tab group support: a leaf may hold several views sharing its tile;
+    // view() is the active (shown) one
+    bool isTabbed() const { return m_tabs.size() > 1; }
+    const std::vector<wayfire_toplevel_view>& tabs() const { return m_tabs; }
+    
+    // Add a view after the active tab and make it active
+    void addTab(wayfire_toplevel_view v)
+    {
+        if (m_tabs.empty())
+            m_tabs.push_back(m_view);
+        
+        auto active = std::find(m_tabs.begin(), m_tabs.end(), m_view);
+        m_tabs.insert(active + 1, v);
+        m_view = v;
+    }
+    
+    // Remove a view from the tab group; the neighbouring tab becomes
+    // active if the removed one was
+    void removeTab(wayfire_toplevel_view v)
+    {
+        auto it = std::find(m_tabs.begin(), m_tabs.end(), v);
+        if (it == m_tabs.end())
+            return;
+        
+        int idx = static_cast<int>(it - m_tabs.begin());
+        m_tabs.erase(it);
+        if (m_view == v)
+            m_view = m_tabs[std::min<int>(idx, m_tabs.size() - 1)];
+        if (m_tabs.size() == 1)
+            m_tabs.clear();
+    }
+    
+    bool activateTab(wayfire_toplevel_view v)
+    {
+        if (m_view == v || std::find(m_tabs.begin(), m_tabs.end(), v) == m_tabs.end())
+            return false;
+        m_view = v;
+        return true;
+    }
+    
+    // Tab `offset` positions away from the active one, wrapping around
+    wayfire_toplevel_view tabAt(int offset) const
+    {
+        if (m_tabs.empty())
+            return m_view;
+        
+        int count = static_cast<int>(m_tabs.size());
+        int idx = static_cast<int>(std::find(m_tabs.begin(), m_tabs.end(), m_view) - m_tabs.begin());
+        return m_tabs[((idx + offset) % count + count) % count];
+    }
+    
+    // Restore a tab group (used when rebuilding a saved tree)
+    void setTabs(std::vector<wayfire_toplevel_view> tabs, wayfire_toplevel_view active)
+    {
+        m_tabs = (tabs.size() > 1) ? std::move(tabs) : std::vector<wayfire_toplevel_view>{};
+        m_view = active;
+    }
+    
+    // Exchange views and tab groups with another leaf
+    void swapContent(TileNode& other)
+    {
+        std::swap(m_view, other.m_view);
+        std::swap(m_tabs, other.m_tabs);
+    }
     SplitDir splitDir() const { return m_splitDir; }
-    void setSplitDir(SplitDir dir) { m_splitDir = dir; }
+    void setSplitDir(SplitDir dir) { m_splitDir = dir; touchInputs(); }
+    
+    // Put back a direction the layout pass resolved itself (not an input)
+    void restoreSplitDir(SplitDir dir) { m_splitDir = dir; }
+    
+    int childCount() const { return static_cast<int>(m_children.size()); }
     
     TileNodePtr child(int idx) const 
     { 
-        return (idx >= 0 && idx < 2) ? m_children[idx] : nullptr; 
+        return (idx >= 0 && idx < childCount()) ? m_children[idx] : nullptr; 
     }
     
-    // Set a child at the given index (0 or 1)
+    // Replace the child at the given index, keeping its weight
     void setChild(int idx, TileNodePtr newChild)
     {
-        if (idx < 0 || idx > 1)
+        if (idx < 0 || idx >= childCount())
             return;
         
         m_children[idx] = newChild;
         if (newChild)
             newChild->m_parent = weak_from_this();
+        touchInputs();
+    }
+    
+    // Insert a child at idx that takes half of the share of the child at
+    // donorIdx; all other children keep their size
+    void insertChildSplitting(int idx, TileNodePtr newChild, int donorIdx)
+    {
+        if (donorIdx < 0 || donorIdx >= childCount())
+            return;
+        
+        idx = std::clamp(idx, 0, childCount());
+        float half = m_weights[donorIdx] / 2.0f;
+        m_weights[donorIdx] = half;
+        
+        m_children.insert(m_children.begin() + idx, newChild);
+        m_weights.insert(m_weights.begin() + idx, half);
+        if (newChild)
+            newChild->m_parent = weak_from_this();
+        touchInputs();
+    }
+    
+    // Remove a child; the remaining weights are re-normalized locally so
+    // siblings grow proportionally into the freed space
+    void removeChild(int idx)
+    {
+        if (idx < 0 || idx >= childCount())
+            return;
+        
+        if (m_children[idx])
+            m_children[idx]->clearParent();
+        m_children.erase(m_children.begin() + idx);
+        m_weights.erase(m_weights.begin() + idx);
+        normalizeWeights();
+        touchInputs();
+    }
+    
+    // Take over all children of a container (used when converting to and
+    // from the binary representation)
+    void adoptChildren(std::vector<TileNodePtr> children, std::vector<float> weights)
+    {
+        m_children = std::move(children);
+        m_weights = std::move(weights);
+        for (auto& c : m_children)
+        {
+            if (c) c->m_parent = weak_from_this();
+        }
+        normalizeWeights();
+        touchInputs();
+    }
+    
+    const std::vector<TileNodePtr>& children() const { return m_children; }
+    const std::vector<float>& weights() const { return m_weights; }
+    
+    float weight(int idx) const
+    {
+        return (idx >= 0 && idx < childCount()) ? m_weights[idx] : 0.0f;
+    }
+    
+    void setWeights(std::vector<float> weights)
+    {
+        if (weights.size() != m_children.size())
+            return;
+        m_weights = std::move(weights);
+        normalizeWeights();
+        touchInputs();
+    }
+    
+    // Reverse child order (and weights), mirroring the container
+    void reverseChildren()
+    {
+        std::reverse(m_children.begin(), m_children.end());
+        std::reverse(m_weights.begin(), m_weights.end());
+        touchInputs();
     }
     
     TileNodePtr parent() const { return m_parent.lock(); }
@@ -393,11 +753,13 @@ class TileNode : public std::enable_shared_from_this<TileNode>
     void setParent(TileNodePtr p) 
     { 
         m_parent = p ? p->weak_from_this() : TileNodeWeak{}; 
+        touchInputs();
     }
     
     void clearParent()
     {
         m_parent.reset();
+        touchInputs();
     }
     
     // Geometry management
@@ -410,27 +772,61 @@ class TileNode : public std::enable_shared_from_this<TileNode>
     }
     
     // Split ratio (0.0 - 1.0, how much space first child takes)
-    float splitRatio() const { return m_splitRatio; }
-    void setSplitRatio(float ratio) { m_splitRatio = std::clamp(ratio, 0.1f, 0.9f); }
+    float splitRatio() const { return m_weights.empty() ? 0.5f : m_weights[0]; }
+    void setSplitRatio(float ratio)
+    {
+        if (m_weights.size() != 2)
+            return;
+        ratio = std::clamp(ratio, 0.1f, 0.9f);
+        m_weights = {ratio, 1.0f - ratio};
+        touchInputs();
+    }
     
     // Pseudotile support
     bool isPseudotiled() const { return m_isPseudotiled; }
-    void setPseudotiled(bool pseudo) { m_isPseudotiled = pseudo; }
+    void setPseudotiled(bool pseudo) { m_isPseudotiled = pseudo; touchInputs(); }
     wf::geometry_t preferredSize() const { return m_preferredSize; }
-    void setPreferredSize(wf::geometry_t size) { m_preferredSize = size; }
+    void setPreferredSize(wf::geometry_t size) { m_preferredSize = size; touchInputs(); }
+    
+    // Where this leaf goes inside `bounds`: the whole tile, or for a
+    // pseudotile its preferred size (clamped to the tile) placed by `align`
+    // (0 = left/top, 0.5 = center, 1 = right/bottom)
+    wf::geometry_t placementIn(wf::geometry_t bounds, wf::pointf_t align) const
+    {
+        if (!m_isLeaf || !m_isPseudotiled ||
+            m_preferredSize.width <= 0 || m_preferredSize.height <= 0)
+        {
+            return bounds;
+        }
+        
+        int width = std::min(m_preferredSize.width, bounds.width);
+        int height = std::min(m_preferredSize.height, bounds.height);
+        return {
+            bounds.x + static_cast<int>(std::lround((bounds.width - width) * align.x)),
+            bounds.y + static_cast<int>(std::lround((bounds.height - height) * align.y)),
+            width,
+            height
+        };
+    }
     
     // Lock split direction (preserve_split)
     bool isSplitLocked() const { return m_splitLocked; }
-    void setSplitLocked(bool locked) { m_splitLocked = locked; }
+    void setSplitLocked(bool locked) { m_splitLocked = locked; touchInputs(); }
+    
+    // Bumped by every edit to a layout input of any node: shape, weights,
+    // directions, pseudotiling. Memoized layouts are keyed on it, so a
+    // lookup costs nothing per node
+    static uint64_t inputGeneration() { return s_inputGeneration; }
     
     // Calculate and apply layout recursively
     // Hyprland-style: recalculate split direction based on aspect ratio unless preserve_split
     void applyLayout(wf::geometry_t bounds, int gapIn, int gapOut, 
-                     bool preserveSplit, float splitWidthMultiplier, bool animate = true)
+                     bool preserveSplit, float splitWidthMultiplier, bool animate = true,
+                     wf::pointf_t pseudoAlign = {0.5, 0.5})
     {
-        m_geometry.setGoal(bounds, animate);
+        m_geometry.setGoal(placementIn(bounds, pseudoAlign), animate);
         
-        if (m_isLeaf)
+        if (m_isLeaf || m_children.empty())
             return;
         
         // Hyprland behavior: dynamically determine split direction based on aspect ratio
@@ -443,64 +839,71 @@ class TileNode : public std::enable_shared_from_this<TileNode>
                 : SplitDir::VERTICAL;
         }
         
-        // Calculate child bounds with proper gap handling
-        wf::geometry_t child1Bounds, child2Bounds;
+        // One linear distribution over all children: edges come from the
+        // cumulative weight, so rounding never compounds across children
+        bool horizontal = (m_splitDir == SplitDir::HORIZONTAL);
+        int count = childCount();
+        int total = horizontal ? bounds.width : bounds.height;
+        int available = total - gapIn * (count - 1);
         
-        if (m_splitDir == SplitDir::HORIZONTAL)
+        float cumulative = 0.0f;
+        int edge = 0;
+        for (int i = 0; i < count; i++)
         {
-            int availableWidth = bounds.width - gapIn;
-            int width1 = static_cast<int>(availableWidth * m_splitRatio);
-            int width2 = availableWidth - width1;
+            cumulative += m_weights[i];
+            int nextEdge = (i == count - 1)
+                ? available
+                : static_cast<int>(available * cumulative);
+            int offset = edge + i * gapIn;
+            int size = nextEdge - edge;
+            edge = nextEdge;
             
-            child1Bounds = {bounds.x, bounds.y, width1, bounds.height};
-            child2Bounds = {bounds.x + width1 + gapIn, bounds.y, width2, bounds.height};
-        }
-        else
-        {
-            int availableHeight = bounds.height - gapIn;
-            int height1 = static_cast<int>(availableHeight * m_splitRatio);
-            int height2 = availableHeight - height1;
+            wf::geometry_t childBounds = horizontal
+                ? wf::geometry_t{bounds.x + offset, bounds.y, size, bounds.height}
+                : wf::geometry_t{bounds.x, bounds.y + offset, bounds.width, size};
             
-            child1Bounds = {bounds.x, bounds.y, bounds.width, height1};
-            child2Bounds = {bounds.x, bounds.y + height1 + gapIn, bounds.width, height2};
+            if (m_children[i])
+                m_children[i]->applyLayout(childBounds, gapIn, gapOut, preserveSplit,
+                                           splitWidthMultiplier, animate, pseudoAlign);
         }
-        
-        if (m_children[0])
-            m_children[0]->applyLayout(child1Bounds, gapIn, gapOut, preserveSplit, splitWidthMultiplier, animate);
-        if (m_children[1])
-            m_children[1]->applyLayout(child2Bounds, gapIn, gapOut, preserveSplit, splitWidthMultiplier, animate);
     }
     
     // Tick animation for this node and all children
-    bool tickAnimation()
+    bool tickAnimation(AnimClock::time_point now)
     {
-        bool animating = m_geometry.tick();
+        bool animating = m_geometry.tick(now);
         
-        if (!m_isLeaf)
+        for (auto& c : m_children)
         {
-            if (m_children[0])
-                animating |= m_children[0]->tickAnimation();
-            if (m_children[1])
-                animating |= m_children[1]->tickAnimation();
+            if (c)
+                animating |= c->tickAnimation(now);
         }
         
         return animating;
     }
     
+    // Visit this node and all of its descendants (pre-order)
+    template<typename F>
+    void forEachNode(F&& fn)
+    {
+        fn(*this);
+        
+        for (auto& c : m_children)
+        {
+            if (c)
+                c->forEachNode(fn);
+        }
+    }
+    
     // Find leaf node containing a specific view
     TileNodePtr findView(wayfire_toplevel_view v)
     {
         if (m_isLeaf)
             return (m_view == v) ? shared_from_this() : nullptr;
         
-        if (m_children[0])
-        {
-            auto found = m_children[0]->findView(v);
-            if (found) return found;
-        }
-        if (m_children[1])
+        for (auto& c : m_children)
         {
-            auto found = m_children[1]->findView(v);
+            auto found = c ? c->findView(v) : nullptr;
             if (found) return found;
         }
         
@@ -525,15 +928,9 @@ class TileNode : public std::enable_shared_from_this<TileNode>
             return shared_from_this();
         
         // Check children
-        if (m_children[0])
-        {
-            auto found = m_children[0]->findNodeAtPoint(point);
-            if (found)
-                return found;
-        }
-        if (m_children[1])
+        for (auto& c : m_children)
         {
-            auto found = m_children[1]->findNodeAtPoint(point);
+            auto found = c ? c->findNodeAtPoint(point) : nullptr;
             if (found)
                 return found;
         }
@@ -546,15 +943,17 @@ class TileNode : public std::enable_shared_from_this<TileNode>
     {
         if (m_isLeaf)
         {
-            if (m_view)
+            if (!m_tabs.empty())
+                out.insert(out.end(), m_tabs.begin(), m_tabs.end());
+            else if (m_view)
                 out.push_back(m_view);
+            return;
         }
-        else
+        
+        for (auto& c : m_children)
         {
-            if (m_children[0])
-                m_children[0]->collectViews(out);
-            if (m_children[1])
-                m_children[1]->collectViews(out);
+            if (c)
+                c->collectViews(out);
         }
     }
     
@@ -565,40 +964,47 @@ class TileNode : public std::enable_shared_from_this<TileNode>
             return m_view ? 1 : 0;
         
         int count = 0;
-        if (m_children[0])
-            count += m_children[0]->countLeaves();
-        if (m_children[1])
-            count += m_children[1]->countLeaves();
+        for (auto& c : m_children)
+        {
+            if (c)
+                count += c->countLeaves();
+        }
         return count;
     }
     
-    // Get which child index this node is in its parent (0 or 1), or -1 if no parent
+    // Get which child index this node is in its parent, or -1 if no parent
     int childIndex() const
     {
         auto p = parent();
         if (!p)
             return -1;
         
-        if (p->child(0).get() == this)
-            return 0;
-        if (p->child(1).get() == this)
-            return 1;
+        for (int i = 0; i < p->childCount(); i++)
+        {
+            if (p->child(i).get() == this)
+                return i;
+        }
         
         return -1;
     }
     
-    // Get sibling node
-    TileNodePtr sibling() const
+    // Get the sibling `offset` positions away in the parent container
+    TileNodePtr siblingAt(int offset) const
     {
         auto p = parent();
-        if (!p)
-            return nullptr;
-        
         int idx = childIndex();
-        if (idx < 0)
+        if (!p || idx < 0)
             return nullptr;
         
-        return p->child(1 - idx);
+        return p->child(idx + offset);
+    }
+    
+    // Get sibling node: the other child of a binary split, otherwise the
+    // next child (or the previous one for the last child)
+    TileNodePtr sibling() const
+    {
+        auto next = siblingAt(1);
+        return next ? next : siblingAt(-1);
     }
     
   public:
@@ -607,18 +1013,32 @@ class TileNode : public std::enable_shared_from_this<TileNode>
   private:
     bool m_isLeaf = true;
     wayfire_toplevel_view m_view = nullptr;
+    std::vector<wayfire_toplevel_view> m_tabs;  // Empty unless tabbed
     
     SplitDir m_splitDir = SplitDir::HORIZONTAL;
-    TileNodePtr m_children[2] = {nullptr, nullptr};
+    std::vector<TileNodePtr> m_children;
+    std::vector<float> m_weights;  // Per-child share, sums to 1
     TileNodeWeak m_parent;
     
-    float m_splitRatio = 0.5f;
     AnimatedGeometry m_geometry;
     
     // Hyprland features
     bool m_isPseudotiled = false;
     wf::geometry_t m_preferredSize{0, 0, 0, 0};
     bool m_splitLocked = false;
+    
+    static inline uint64_t s_inputGeneration = 0;
+    static void touchInputs() { s_inputGeneration++; }
+    
+    void normalizeWeights()
+    {
+        float sum = 0.0f;
+        for (float w : m_weights)
+            sum += w;
+        
+        for (auto& w : m_weights)
+            w = (sum > 0.0f) ? w / sum : 1.0f / m_weights.size();
+    }
 };
 
 // ============================================================================
@@ -632,7 +1052,8 @@ class TileTree
     
     void setConfig(BezierCurve* curve, float durationMs, int gapIn, int gapOut,
                    bool preserveSplit, float splitWidthMultiplier, int forceSplit,
-                   bool smartSplit)
+                   bool smartSplit, bool naryContainers,
+                   int minTileWidth, int minTileHeight)
     {
         m_curve = curve;
         m_durationMs = durationMs;
@@ -642,6 +1063,14 @@ class TileTree
         m_splitWidthMultiplier = splitWidthMultiplier;
         m_forceSplit = forceSplit;
         m_smartSplit = smartSplit;
+        m_naryContainers = naryContainers;
+        m_minTileWidth = minTileWidth;
+        m_minTileHeight = minTileHeight;
+        
+        // Existing nodes follow (e.g. a tree re-adopted by a new plugin
+        // instance must not keep the old instance's curve)
+        if (m_root)
+            m_root->forEachNode([&] (TileNode& n) { n.setConfig(curve, durationMs); });
     }
     
     void setBounds(wf::geometry_t bounds)
@@ -652,6 +1081,12 @@ class TileTree
     void setFocusedView(wayfire_toplevel_view view)
     {
         m_focusedView = view;
+        touchFocusHistory(view);
+        
+        // Focusing a background tab brings it to the front of its group
+        if (auto leaf = view ? lookupLeaf(view) : nullptr)
+            leaf->activateTab(view);
+        publishLayout();
     }
     
     void setCursorPosition(wf::point_t pos)
@@ -662,17 +1097,68 @@ class TileTree
     // Get the current window count
     int getWindowCount() const
     {
-        if (!m_root)
-            return 0;
-        return m_root->countLeaves();
+        return static_cast<int>(m_leafIndex.size());
+    }
+    
+    // Number of animated values (x, y, size, scale, alpha) still moving
+    int countAnimatingChannels() const
+    {
+        int count = 0;
+        if (m_root)
+            m_root->forEachNode([&count] (TileNode& n) { count += n.geometry().animatingChannels(); });
+        return count;
+    }
+    
+    // Number of tiles with a running transition
+    int countAnimating() const
+    {
+        int count = 0;
+        if (m_root)
+        {
+            m_root->forEachNode([&count] (TileNode& n)
+            {
+                if (n.isLeaf() && n.geometry().isAnimating())
+                    count++;
+            });
+        }
+        return count;
     }
     
     // Add a view to the tree - Hyprland style
     // Splits the focused window (not deepest leaf) unless no focus
     void addView(wayfire_toplevel_view view, bool animate = true)
     {
+        // Most recently focused surviving leaf, picked before the new view
+        // (which may already be marked focused) enters the history
+        TileNodePtr mruLeaf = getMostRecentLeaf();
+        
+        // A preselected split wins over focus/force_split/smart_split
+        auto preselect = peekPreselection();
+        
+        // When splitting the target would create a tile below the minimum
+        // size, the new window joins the target's tab group instead
+        auto tabTarget = preselect ? preselect->leaf
+            : (m_root && m_root->isLeaf()) ? m_root
+            : mruLeaf ? mruLeaf : findLastLeaf(m_root);
+        if (tabTarget && !splitFits(tabTarget, preselect))
+        {
+            // The preselection stays for a window that fits
+            tabTarget->addTab(view);
+            m_leafIndex[view.get()] = tabTarget;
+            if (view == m_focusedView)
+                touchFocusHistory(view);
+            publishLayout();
+            return;
+        }
+        m_preselect.reset();
+        
         auto newLeaf = TileNode::createLeaf(view);
         newLeaf->setConfig(m_curve, m_durationMs);
+        invalidateLayoutCache();
+        
+        // The size the client mapped with is what a pseudotile keeps
+        newLeaf->setPreferredSize(view->get_geometry());
+        m_leafIndex[view.get()] = newLeaf;
         
         // Apply outer gaps to the effective bounds
         wf::geometry_t effectiveBounds = {
@@ -682,7 +1168,15 @@ class TileTree
             m_bounds.height - 2 * m_gapOut
         };
         
-        if (!m_root)
+        if (preselect)
+        {
+            auto split = insertSplit(preselect->leaf, newLeaf, preselect->dir,
+                                     !preselect->newFirst, false);
+            split->setSplitRatio(preselect->newFirst ? preselect->ratio : 1.0f - preselect->ratio);
+            split->setSplitLocked(true);
+            newLeaf->geometry().startPopin(0.8f);
+        }
+        else if (!m_root)
         {
             // First window - just becomes the root
             m_root = newLeaf;
@@ -724,16 +1218,11 @@ class TileTree
         }
         else
         {
-            // Third+ window: split the focused window (Hyprland behavior)
-            TileNodePtr targetLeaf = nullptr;
-            
-            // Try to find the focused view's node
-            if (m_focusedView)
-            {
-                targetLeaf = m_root->findView(m_focusedView);
-            }
+            // Third+ window: split the most recently focused window
+            // (Hyprland behavior), found in O(1) through the focus history
+            TileNodePtr targetLeaf = mruLeaf;
             
-            // Fallback to last leaf if no focus
+            // Fallback to last leaf if nothing in this tree was focused yet
             if (!targetLeaf)
             {
                 targetLeaf = findLastLeaf(m_root);
@@ -746,19 +1235,106 @@ class TileTree
             }
         }
         
+        if (view == m_focusedView)
+            touchFocusHistory(view);
+        
         recalculateLayout(animate);
+        
+        // The final geometry is known before the first configure, so the
+        // new window starts there instead of sliding in from a guess
+        if (preselect)
+            newLeaf->geometry().warp(newLeaf->geometry().goal());
+    }
+    
+    // Put newView into oldView's leaf in place: same goal geometry, no
+    // relayout and no sibling animations
+    TileNodePtr replaceView(wayfire_toplevel_view oldView, wayfire_toplevel_view newView)
+    {
+        auto leaf = lookupLeaf(oldView);
+        if (!leaf)
+            return nullptr;
+        
+        leaf->replaceTab(oldView, newView);
+        m_leafIndex.erase(oldView.get());
+        m_leafIndex[newView.get()] = leaf;
+        forgetFocusHistory(oldView);
+        if (newView == m_focusedView)
+            touchFocusHistory(newView);
+        publishLayout();
+        return leaf;
+    }
+    
+    // Declare where the next window goes: split `leaf` in `dir`, with the
+    // new window first (left/top) or second, taking `ratio` of the space
+    void setPreselection(TileNodePtr leaf, SplitDir dir, bool newFirst, float ratio)
+    {
+        if (!leaf || !leaf->isLeaf())
+            return;
+        m_preselect = Preselection{leaf, dir, newFirst, std::clamp(ratio, 0.1f, 0.9f)};
+    }
+    
+    void clearPreselection() { m_preselect.reset(); }
+    
+    // Terminals swallowed by a view of this tree (view -> terminal) while
+    // the tree is parked; the terminals are hidden again on adoption
+    using SwallowPair = std::pair<wayfire_toplevel_view, wayfire_toplevel_view>;
+    
+    void parkSwallow(wayfire_toplevel_view view, wayfire_toplevel_view terminal)
+    {
+        m_parkedSwallows.push_back({view, terminal});
+    }
+    
+    std::vector<SwallowPair> takeParkedSwallows()
+    {
+        return std::exchange(m_parkedSwallows, {});
+    }
+    
+    // Area the next window would get, for the preselection overlay
+    std::optional<wf::geometry_t> getPreselectionGeometry() const
+    {
+        auto leaf = validPreselectLeaf();
+        if (!leaf)
+            return std::nullopt;
+        
+        auto geo = leaf->geometry().goal();
+        bool horizontal = (m_preselect->dir == SplitDir::HORIZONTAL);
+        int total = (horizontal ? geo.width : geo.height) - m_gapIn;
+        int size = static_cast<int>(total * m_preselect->ratio);
+        int offset = m_preselect->newFirst ? 0 : total - size + m_gapIn;
+        
+        if (horizontal)
+            return wf::geometry_t{geo.x + offset, geo.y, size, geo.height};
+        return wf::geometry_t{geo.x, geo.y + offset, geo.width, size};
     }
     
     // Remove a view from the tree
     void removeView(wayfire_toplevel_view view, bool animate = true)
     {
+        // A parked swallow goes away with either of its windows
+        m_parkedSwallows.erase(std::remove_if(m_parkedSwallows.begin(), m_parkedSwallows.end(),
+            [&view] (const SwallowPair& p) { return p.first == view || p.second == view; }),
+            m_parkedSwallows.end());
+        
         if (!m_root)
             return;
         
-        auto node = m_root->findView(view);
+        auto node = lookupLeaf(view);
         if (!node)
             return;
         
+        m_leafIndex.erase(view.get());
+        forgetFocusHistory(view);
+        
+        // Leaving a tab group does not change the tree
+        if (node->isTabbed())
+        {
+            node->removeTab(view);
+            publishLayout();
+            return;
+        }
+        
+        invalidateLayoutCache();
+        
         // Start popout animation before removing
         node->geometry().startPopout(0.8f);
         
@@ -767,11 +1343,22 @@ class TileTree
         {
             // This was the only window (root leaf)
             m_root = nullptr;
+            publishLayout();
             return;
         }
         
-        // Find sibling (the other child of parent)
         int nodeIdx = node->childIndex();
+        
+        // N-ary container: drop the child and re-normalize its siblings'
+        // weights in place, without restructuring the tree
+        if (parent->childCount() > 2)
+        {
+            parent->removeChild(nodeIdx);
+            recalculateLayout(animate);
+            return;
+        }
+        
+        // Find sibling (the other child of parent)
         int siblingIdx = 1 - nodeIdx;
         TileNodePtr sibling = parent->child(siblingIdx);
         
@@ -796,39 +1383,51 @@ class TileTree
     // Check if tree contains a view
     bool hasView(wayfire_toplevel_view view) const
     {
-        if (!m_root)
-            return false;
-        return const_cast<TileNode*>(m_root.get())->findView(view) != nullptr;
+        return m_leafIndex.count(view.get()) > 0;
     }
     
     // Tick all animations, returns true if still animating
-    bool tickAnimations()
+    bool tickAnimations(AnimClock::time_point now)
     {
         if (!m_root)
             return false;
-        return m_root->tickAnimation();
+        return m_root->tickAnimation(now);
     }
     
-    // Get current geometry for a view (for applying to actual window)
-    std::optional<wf::geometry_t> getViewGeometry(wayfire_toplevel_view view) const
+    // Gesture support: freeze the transition started by the last relayout
+    // and drive it from an external progress value instead of the clock
+    void beginScrub()
     {
-        if (!m_root)
-            return std::nullopt;
-        
-        auto node = const_cast<TileNode*>(m_root.get())->findView(view);
-        if (!node)
-            return std::nullopt;
-        
-        return node->geometry().current();
+        if (m_root)
+            m_root->forEachNode([] (TileNode& n) { n.geometry().beginScrub(); });
     }
     
-    // Get goal geometry for a view
-    std::optional<wf::geometry_t> getViewGoalGeometry(wayfire_toplevel_view view) const
+    void scrub(float progress)
     {
-        if (!m_root)
+        if (m_root)
+            m_root->forEachNode([progress] (TileNode& n) { n.geometry().scrub(progress); });
+    }
+    
+    void releaseScrub(float durationMs)
+    {
+        if (m_root)
+            m_root->forEachNode([durationMs] (TileNode& n) { n.geometry().release(durationMs); });
+    }
+    
+    // Get current (sub-pixel) geometry for a view (for applying to actual window)
+    std::optional<GeometryF> getViewGeometry(wayfire_toplevel_view view) const
+    {
+        auto node = lookupLeaf(view);
+        if (!node)
             return std::nullopt;
         
-        auto node = const_cast<TileNode*>(m_root.get())->findView(view);
+        return node->geometry().current();
+    }
+    
+    // Get goal geometry for a view
+    std::optional<wf::geometry_t> getViewGoalGeometry(wayfire_toplevel_view view) const
+    {
+        auto node = lookupLeaf(view);
         if (!node)
             return std::nullopt;
         
@@ -838,10 +1437,7 @@ class TileTree
     // Get animation scale/alpha for a view (for popin/popout effects)
     std::pair<float, float> getViewScaleAlpha(wayfire_toplevel_view view) const
     {
-        if (!m_root)
-            return {1.0f, 1.0f};
-        
-        auto node = const_cast<TileNode*>(m_root.get())->findView(view);
+        auto node = lookupLeaf(view);
         if (!node)
             return {1.0f, 1.0f};
         
@@ -857,10 +1453,112 @@ class TileTree
         return views;
     }
     
-    bool isEmpty() const { return !m_root || m_root->countLeaves() == 0; }
+    bool isEmpty() const { return m_leafIndex.empty(); }
+    
+    LayoutMode layoutMode() const { return m_layoutMode; }
+    
+    // Force a layout mode on this tree, or go back to the automatic choice
+    // with nullopt. The tree itself is never rebuilt, so switching back
+    // restores the exact previous layout
+    void setLayoutMode(std::optional<LayoutMode> mode, bool animate = true)
+    {
+        m_manualMode = mode;
+        recalculateLayout(animate);
+    }
+    
+    bool hasManualLayoutMode() const { return m_manualMode.has_value(); }
+    
+    void setLayoutPolicy(LayoutPolicy policy)
+    {
+        m_layoutPolicy = std::move(policy);
+    }
+    
+    void setPseudotileAlign(wf::pointf_t align)
+    {
+        m_pseudoAlign = align;
+    }
+    
+    // Leaf shown in monocle mode: the focused view, else the most recently
+    // focused one, else the first leaf
+    TileNodePtr getMonocleLeaf() const
+    {
+        if (auto leaf = m_focusedView ? lookupLeaf(m_focusedView) : nullptr)
+            return leaf;
+        if (auto leaf = getMostRecentLeaf())
+            return leaf;
+        
+        std::vector<wayfire_toplevel_view> views;
+        if (m_root)
+            m_root->collectViews(views);
+        return views.empty() ? nullptr : lookupLeaf(views.front());
+    }
+    
+    // Views that are actually shown (and configured) in the current mode
+    std::vector<wayfire_toplevel_view> getVisibleViews() const
+    {
+        if (m_layoutMode == LayoutMode::MONOCLE)
+        {
+            auto leaf = getMonocleLeaf();
+            if (!leaf)
+                return {};
+            return {leaf->view()};
+        }
+        
+        // Background tabs are not shown
+        auto views = getViews();
+        views.erase(std::remove_if(views.begin(), views.end(),
+            [this] (const wayfire_toplevel_view& v) { return lookupLeaf(v)->view() != v; }),
+            views.end());
+        return views;
+    }
+    
+    // Leaf of the currently focused view, if it lives in this tree
+    TileNodePtr getFocusedNode()
+    {
+        if (!m_focusedView)
+            return nullptr;
+        return lookupLeaf(m_focusedView);
+    }
+    
+    // Tab `offset` positions away in the focused leaf's group, or nullptr
+    // if the focused leaf is not tabbed
+    wayfire_toplevel_view getFocusedTab(int offset)
+    {
+        auto leaf = getFocusedNode();
+        if (!leaf || !leaf->isTabbed())
+            return nullptr;
+        return leaf->tabAt(offset);
+    }
+    
+    // Most recently focused view in this tree other than the current one
+    // (the target of "focus last")
+    // Position of a view in the MRU focus history (0 = most recent), or
+    // INT_MAX if it was never focused
+    int focusRank(wayfire_toplevel_view view) const
+    {
+        auto it = m_focusHistoryPos.find(view.get());
+        if (it == m_focusHistoryPos.end())
+            return INT_MAX;
+        return static_cast<int>(std::distance(m_focusHistory.begin(),
+            std::list<wayfire_toplevel_view>::const_iterator(it->second)));
+    }
+    
+    wayfire_toplevel_view getPreviousFocus() const
+    {
+        for (auto& view : m_focusHistory)
+        {
+            if (view != m_focusedView)
+                return view;
+        }
+        return nullptr;
+    }
     
     void recalculateLayout(bool animate = true)
     {
+        // Crossing a policy threshold switches the engine as part of this
+        // relayout, so it is one animated transition
+        m_layoutMode = resolveLayoutMode();
+        
         if (m_root)
         {
             // Apply outer gaps to effective bounds
@@ -871,17 +1569,166 @@ class TileTree
                 m_bounds.height - 2 * m_gapOut
             };
             
-            m_root->applyLayout(effectiveBounds, m_gapIn, m_gapOut, 
-                               m_preserveSplit, m_splitWidthMultiplier, animate);
+            // Toggling back to a recent mode/state is a table lookup
+            auto key = makeLayoutKey(effectiveBounds);
+            if (applyCachedLayout(key, animate))
+            {
+                publishLayout();
+                return;
+            }
+            
+            if (m_layoutMode == LayoutMode::GRID)
+                applyGridLayout(effectiveBounds, animate);
+            else
+                m_root->applyLayout(effectiveBounds, m_gapIn, m_gapOut, 
+                                   m_preserveSplit, m_splitWidthMultiplier, animate,
+                                   m_pseudoAlign);
+            
+            // Monocle: the tree keeps its tiled goals, only the shown leaf
+            // is stretched over the whole workspace
+            if (m_layoutMode == LayoutMode::MONOCLE)
+            {
+                if (auto leaf = getMonocleLeaf())
+                    leaf->geometry().setGoal(leaf->placementIn(effectiveBounds, m_pseudoAlign), animate);
+            }
+            
+            storeLayout(key);
+        }
+        
+        publishLayout();
+    }
+    
+    // ------------------------------------------------------------------
+    // Snapshot - plain-text state that survives unloading the plugin code
+    // ------------------------------------------------------------------
+    
+    using ViewLookup = std::function<wayfire_toplevel_view(uint64_t)>;
+    
+    // Wayfire's view id (never reused within a session) with a hash of the
+    // app id, so a stale snapshot cannot bind an unrelated window
+    static uint64_t viewId(wayfire_toplevel_view view)
+    {
+        uint32_t h = 2166136261u;
+        for (unsigned char c : view->get_app_id())
+        {
+            h ^= c;
+            h *= 16777619u;
+        }
+        return (static_cast<uint64_t>(view->get_id()) << 32) | h;
+    }
+    
+    void serialize(std::ostream& out) const
+    {
+        out << "tree " << (m_manualMode ? static_cast<int>(*m_manualMode) : -1)
+            << " " << viewId(m_focusedView) << " " << m_focusHistory.size();
+        for (auto& view : m_focusHistory)
+            out << " " << viewId(view);
+        out << " " << m_parkedSwallows.size();
+        for (auto& [view, terminal] : m_parkedSwallows)
+            out << " " << viewId(view) << " " << viewId(terminal);
+        out << "\n";
+        serializeNode(out, m_root);
+    }
+    
+    // Rebuild a tree saved by serialize(), binding views by identity;
+    // views that no longer exist are dropped and their splits collapse
+    static std::unique_ptr<TileTree> deserialize(std::istream& in, const ViewLookup& lookup)
+    {
+        std::string tag;
+        int mode;
+        uint64_t focused;
+        size_t historySize;
+        if (!(in >> tag >> mode >> focused >> historySize) || tag != "tree")
+            return nullptr;
+        
+        std::vector<uint64_t> history(historySize);
+        for (auto& id : history)
+            in >> id;
+        
+        size_t swallowCount;
+        in >> swallowCount;
+        std::vector<std::pair<uint64_t, uint64_t>> swallows(in ? swallowCount : 0);
+        for (auto& [view, terminal] : swallows)
+            in >> view >> terminal;
+        
+        auto tree = std::make_unique<TileTree>();
+        tree->m_root = deserializeNode(in, lookup);
+        if (in.fail())
+            return nullptr;
+        
+        if (tree->m_root)
+        {
+            tree->m_root->clearParent();
+            tree->m_root->forEachNode([&] (TileNode& n)
+            {
+                if (!n.isLeaf())
+                    return;
+                if (n.isTabbed())
+                {
+                    for (auto& tab : n.tabs())
+                        tree->m_leafIndex[tab.get()] = n.shared_from_this();
+                }
+                else if (n.view())
+                {
+                    tree->m_leafIndex[n.view().get()] = n.shared_from_this();
+                }
+            });
+        }
+        
+        if (mode >= 0)
+            tree->m_manualMode = static_cast<LayoutMode>(mode);
+        
+        // Oldest first, so the most recent ends up in front
+        for (auto id = history.rbegin(); id != history.rend(); ++id)
+        {
+            if (auto view = lookup(*id))
+                tree->touchFocusHistory(view);
         }
+        
+        auto focusedView = lookup(focused);
+        if (focusedView && tree->hasView(focusedView))
+            tree->m_focusedView = focusedView;
+        
+        for (auto& [viewId, terminalId] : swallows)
+        {
+            auto view = lookup(viewId);
+            auto terminal = lookup(terminalId);
+            if (view && terminal && tree->hasView(view) && !tree->hasView(terminal))
+                tree->parkSwallow(view, terminal);
+        }
+        
+        tree->m_layoutMode = tree->resolveLayoutMode();
+        tree->publishLayout();
+        return tree;
+    }
+    
+    // Goal geometry of every view, kept up to date for other plugins
+    const animated_tile::workspace_layout_t& publishedLayout() const
+    {
+        return m_published;
+    }
+    
+    // Output mode/scale change: jump straight to the layout for the new
+    // bounds - current and goal geometry both land on it, so there is no
+    // transition and every window gets exactly one configure
+    void remapToBounds(wf::geometry_t bounds)
+    {
+        m_bounds = bounds;
+        invalidateLayoutCache();
+        recalculateLayout(false);
+    }
+    
+    // Drop all memoized layouts; called on structural edits (the node
+    // generation already moved on, this just frees the dead entries)
+    void invalidateLayoutCache()
+    {
+        m_layoutCache.clear();
     }
     
     // Find the node containing a specific view
     TileNodePtr getNodeForView(wayfire_toplevel_view view)
     {
-        if (!m_root)
-            return nullptr;
-        return m_root->findView(view);
+        return lookupLeaf(view);
     }
     
     // Find node at a specific point
@@ -893,7 +1740,9 @@ class TileTree
     }
     
     // Swap two leaf nodes in the tree (swap their views)
-    void swapNodes(TileNodePtr nodeA, TileNodePtr nodeB)
+    // With animate, each view keeps its on-screen geometry and slides to the
+    // other tile on the next relayout instead of teleporting
+    void swapNodes(TileNodePtr nodeA, TileNodePtr nodeB, bool animate = false)
     {
         if (!nodeA || !nodeB || !nodeA->isLeaf() || !nodeB->isLeaf())
             return;
@@ -907,9 +1756,28 @@ class TileTree
         auto geoA = nodeA->geometry().goal();
         auto geoB = nodeB->geometry().goal();
         
-        // Swap the views between the two leaf nodes
-        nodeA->setView(viewB);
-        nodeB->setView(viewA);
+        // Swap the views (and tab groups) between the two leaf nodes
+        nodeA->swapContent(*nodeB);
+        for (auto& node : {nodeA, nodeB})
+        {
+            if (node->isTabbed())
+            {
+                for (auto& tab : node->tabs())
+                    m_leafIndex[tab.get()] = node;
+            }
+            else if (node->view())
+            {
+                m_leafIndex[node->view().get()] = node;
+            }
+        }
+        
+        publishLayout();
+        
+        if (animate)
+        {
+            std::swap(nodeA->geometry(), nodeB->geometry());
+            return;
+        }
         
         // Force immediate application - no animation for the swap itself
         // The views just teleport to their new positions
@@ -925,14 +1793,39 @@ class TileTree
         if (!m_root)
             return;
         
+        // Whole-tree transforms: one pass over the tree, one relayout
+        if (msg == "equalize")
+        {
+            equalizeNode(m_root);
+            recalculateLayout(true);
+            return;
+        }
+        else if (msg == "rotate")
+        {
+            m_root->forEachNode([] (TileNode& n) { rotateNode(n); });
+            recalculateLayout(true);
+            return;
+        }
+        else if (msg == "mirrorh" || msg == "mirrorv")
+        {
+            SplitDir axis = (msg == "mirrorh") ? SplitDir::HORIZONTAL : SplitDir::VERTICAL;
+            m_root->forEachNode([axis] (TileNode& n)
+            {
+                if (!n.isLeaf() && n.splitDir() == axis)
+                    n.reverseChildren();
+            });
+            recalculateLayout(true);
+            return;
+        }
+        
         TileNodePtr targetNode = nullptr;
         if (targetView)
         {
-            targetNode = m_root->findView(targetView);
+            targetNode = lookupLeaf(targetView);
         }
         else if (m_focusedView)
         {
-            targetNode = m_root->findView(m_focusedView);
+            targetNode = lookupLeaf(m_focusedView);
         }
         
         if (!targetNode)
@@ -954,13 +1847,29 @@ class TileTree
         }
         else if (msg == "swapnext" || msg == "swapprev")
         {
-            // Swap with sibling
-            TileNodePtr sibling = targetNode->sibling();
-            if (sibling && parent)
+            // Swap with sibling (next/previous child of an n-ary container)
+            TileNodePtr sibling = (parent->childCount() > 2)
+                ? targetNode->siblingAt(msg == "swapnext" ? 1 : -1)
+                : targetNode->sibling();
+            if (sibling && sibling->isLeaf())
             {
                 swapNodes(targetNode, sibling);
             }
         }
+        else if (msg == "flatten")
+        {
+            // Merge chains of same-direction splits into n-ary containers
+            flattenNode(m_root);
+            invalidateLayoutCache();
+            recalculateLayout(true);
+        }
+        else if (msg == "binarize")
+        {
+            // Expand n-ary containers back into binary dwindle splits
+            binarizeNode(m_root);
+            invalidateLayoutCache();
+            recalculateLayout(true);
+        }
         else if (msg == "swapwithcursor")
         {
             // Swap focused window with window under cursor
@@ -972,13 +1881,14 @@ class TileTree
         }
         else if (msg == "pseudo")
         {
-            // Toggle pseudotile
+            // Toggle pseudotile: the leaf keeps the size its client mapped
+            // with (or has now, if that is unknown) inside its tile
             targetNode->setPseudotiled(!targetNode->isPseudotiled());
-            if (targetNode->isPseudotiled() && targetView)
+            auto preferred = targetNode->preferredSize();
+            if (targetNode->isPseudotiled() &&
+                (preferred.width <= 0 || preferred.height <= 0))
             {
-                // Store current size as preferred
-                auto currentGeo = targetView->get_geometry();
-                targetNode->setPreferredSize(currentGeo);
+                targetNode->setPreferredSize(targetNode->view()->get_geometry());
             }
             recalculateLayout(true);
         }
@@ -997,687 +1907,3641 @@ class TileTree
     float m_splitWidthMultiplier = 1.0f;
     int m_forceSplit = 0;  // 0=mouse, 1=left/top, 2=right/bottom
     bool m_smartSplit = false;
+    bool m_naryContainers = false;  // Insert into same-direction parents
+    int m_minTileWidth = 0;   // Below this, new windows become tabs
+    int m_minTileHeight = 0;
+    wf::pointf_t m_pseudoAlign{0.5, 0.5};  // Pseudotile placement in its tile
     
-    wayfire_toplevel_view m_focusedView = nullptr;
-    wf::point_t m_cursorPos{0, 0};
+    LayoutMode m_layoutMode = LayoutMode::DWINDLE;
+    std::optional<LayoutMode> m_manualMode;
+    LayoutPolicy m_layoutPolicy;
     
-    // Determine split direction based on Hyprland rules
-    SplitDir determineSplitDirection(wf::geometry_t bounds, TileNodePtr existingNode)
+    // Manual mode if set, else the last policy rule the leaf count reaches
+    LayoutMode resolveLayoutMode() const
     {
-        if (m_smartSplit && existingNode)
+        if (m_manualMode)
+            return *m_manualMode;
+        
+        LayoutMode mode = LayoutMode::DWINDLE;
+        for (auto& [minCount, ruleMode] : m_layoutPolicy)
         {
-            // Smart split: based on cursor position relative to window center
-            auto nodeGeo = existingNode->geometry().goal();
-            int centerX = nodeGeo.x + nodeGeo.width / 2;
-            int centerY = nodeGeo.y + nodeGeo.height / 2;
-            
-            int dx = std::abs(m_cursorPos.x - centerX);
-            int dy = std::abs(m_cursorPos.y - centerY);
-            
-            // Normalize by dimensions
-            float relX = static_cast<float>(dx) / (nodeGeo.width / 2);
-            float relY = static_cast<float>(dy) / (nodeGeo.height / 2);
-            
-            return (relX > relY) ? SplitDir::HORIZONTAL : SplitDir::VERTICAL;
+            if (getWindowCount() >= minCount)
+                mode = ruleMode;
         }
-        
-        // Default: aspect ratio based (Hyprland default behavior)
-        float effectiveWidth = bounds.width * m_splitWidthMultiplier;
-        return (effectiveWidth > bounds.height) ? SplitDir::HORIZONTAL : SplitDir::VERTICAL;
+        return mode;
     }
     
-    // Calculate starting geometry for new window (for smooth animation)
-    wf::geometry_t calculateNewWindowStart(wf::geometry_t bounds, SplitDir dir, bool newOnLeft)
+    // Flat grid: leaves in tree order, ceil(sqrt(n)) columns, a short last
+    // row spread over the full width. Containers get the whole area so
+    // hit-testing still reaches every leaf
+    void applyGridLayout(wf::geometry_t bounds, bool animate)
     {
-        if (dir == SplitDir::HORIZONTAL)
+        std::vector<TileNode*> leaves;
+        m_root->forEachNode([&] (TileNode& n)
         {
-            int halfWidth = bounds.width / 2;
-            if (newOnLeft)
-            {
-                return {bounds.x, bounds.y, halfWidth, bounds.height};
-            }
+            if (n.isLeaf())
+                leaves.push_back(&n);
             else
-            {
-                return {bounds.x + halfWidth, bounds.y, halfWidth, bounds.height};
-            }
-        }
-        else
+                n.geometry().setGoal(bounds, animate);
+        });
+        
+        int count = static_cast<int>(leaves.size());
+        if (count == 0)
+            return;
+        
+        int cols = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(count))));
+        int rows = (count + cols - 1) / cols;
+        int cellHeight = (bounds.height - m_gapIn * (rows - 1)) / rows;
+        
+        for (int i = 0; i < count; i++)
         {
-            int halfHeight = bounds.height / 2;
-            if (newOnLeft)
-            {
-                return {bounds.x, bounds.y, bounds.width, halfHeight};
-            }
-            else
-            {
-                return {bounds.x, bounds.y + halfHeight, bounds.width, halfHeight};
-            }
+            int row = i / cols;
+            int col = i % cols;
+            int rowCols = (row == rows - 1) ? count - row * cols : cols;
+            int cellWidth = (bounds.width - m_gapIn * (rowCols - 1)) / rowCols;
+            
+            leaves[i]->geometry().setGoal(leaves[i]->placementIn({
+                bounds.x + col * (cellWidth + m_gapIn),
+                bounds.y + row * (cellHeight + m_gapIn),
+                cellWidth,
+                cellHeight
+            }, m_pseudoAlign), animate);
         }
     }
     
-    // Find the deepest, rightmost leaf (fallback for dwindle style)
-    TileNodePtr findLastLeaf(TileNodePtr node)
+    static void serializeNode(std::ostream& out, const TileNodePtr& node)
     {
         if (!node)
-            return nullptr;
-        if (node->isLeaf())
-            return node;
+        {
+            out << "none\n";
+            return;
+        }
         
-        // In dwindle, prefer second child (that's where new windows typically go)
-        if (node->child(1))
+        auto g = node->geometry().goal();
+        out << (node->isLeaf() ? "leaf " : "split ")
+            << g.x << " " << g.y << " " << g.width << " " << g.height;
+        
+        if (node->isLeaf())
         {
-            auto found = findLastLeaf(node->child(1));
-            if (found)
-                return found;
+            auto views = node->isTabbed() ? node->tabs()
+                : std::vector<wayfire_toplevel_view>{node->view()};
+            auto active = std::find(views.begin(), views.end(), node->view()) - views.begin();
+            auto preferred = node->preferredSize();
+            
+            out << " " << node->isPseudotiled() << " " << preferred.width << " "
+                << preferred.height << " " << active << " " << views.size();
+            for (auto& view : views)
+                out << " " << viewId(view);
+            out << "\n";
+            return;
         }
         
-        return findLastLeaf(node->child(0));
+        out << " " << static_cast<int>(node->splitDir()) << " " << node->isSplitLocked()
+            << " " << node->childCount() << std::setprecision(9);
+        for (float w : node->weights())
+            out << " " << w;
+        out << "\n";
+        
+        for (auto& c : node->children())
+            serializeNode(out, c);
     }
     
-    // Insert newLeaf by splitting existingLeaf
-    void insertAtLeaf(TileNodePtr existingLeaf, TileNodePtr newLeaf)
+    static TileNodePtr deserializeNode(std::istream& in, const ViewLookup& lookup)
     {
-        auto parent = existingLeaf->parent();
-        int existingChildIdx = existingLeaf->childIndex();
-        
-        // Determine split direction
-        auto existingGeo = existingLeaf->geometry().goal();
-        SplitDir dir = determineSplitDirection(existingGeo, existingLeaf);
+        std::string tag;
+        if (!(in >> tag) || tag == "none")
+            return nullptr;
         
-        // Calculate starting position for new leaf
-        wf::geometry_t newLeafStart;
-        bool newOnRight = (m_forceSplit != 1);  // Default is right/bottom
+        wf::geometry_t g;
+        in >> g.x >> g.y >> g.width >> g.height;
         
-        if (m_forceSplit == 0 && m_smartSplit)
+        if (tag == "leaf")
         {
-            // Use cursor position to determine side
-            int centerX = existingGeo.x + existingGeo.width / 2;
-            int centerY = existingGeo.y + existingGeo.height / 2;
+            int pseudo, prefWidth, prefHeight;
+            size_t active, count;
+            in >> pseudo >> prefWidth >> prefHeight >> active >> count;
             
-            if (dir == SplitDir::HORIZONTAL)
-            {
-                newOnRight = (m_cursorPos.x > centerX);
-            }
-            else
+            std::vector<wayfire_toplevel_view> views;
+            wayfire_toplevel_view activeView = nullptr;
+            for (size_t i = 0; i < count && in; i++)
             {
-                newOnRight = (m_cursorPos.y > centerY);
+                uint64_t id;
+                in >> id;
+                if (auto view = lookup(id))
+                {
+                    views.push_back(view);
+                    if (i == active)
+                        activeView = view;
+                }
             }
+            
+            if (views.empty())
+                return nullptr;
+            
+            auto leaf = TileNode::createLeaf(activeView ? activeView : views.front());
+            leaf->setTabs(views, leaf->view());
+            leaf->setPseudotiled(pseudo != 0);
+            leaf->setPreferredSize({0, 0, prefWidth, prefHeight});
+            leaf->geometry().warp(g);
+            return leaf;
         }
         
-        newLeafStart = calculateNewWindowStart(existingGeo, dir, !newOnRight);
-        newLeaf->geometry().warp(newLeafStart);
+        int dir, locked;
+        size_t count;
+        in >> dir >> locked >> count;
+        if (!in || count > 4096)
+            return nullptr;
         
-        // Create split with appropriate child order
-        TileNodePtr first, second;
-        if (newOnRight)
+        std::vector<float> weights(count);
+        for (auto& w : weights)
+            in >> w;
+        
+        std::vector<TileNodePtr> children;
+        std::vector<float> childWeights;
+        for (size_t i = 0; i < count && in; i++)
         {
-            first = existingLeaf;
-            second = newLeaf;
-        }
-        else
-        {
-            first = newLeaf;
-            second = existingLeaf;
+            if (auto child = deserializeNode(in, lookup))
+            {
+                children.push_back(child);
+                childWeights.push_back(weights[i]);
+            }
         }
         
-        auto newSplit = TileNode::createSplit(dir, first, second);
-        newSplit->setConfig(m_curve, m_durationMs);
+        if (children.empty())
+            return nullptr;
+        if (children.size() == 1)
+            return children.front();
+        
+        auto split = TileNode::createContainer(static_cast<SplitDir>(dir), children);
+        split->setWeights(childWeights);
+        split->setSplitLocked(locked != 0);
+        split->geometry().warp(g);
+        return split;
+    }
+    
+    // Published goals (see layout-query.hpp), updated in place so readers
+    // never see a reallocation unless the number of views changed
+    animated_tile::workspace_layout_t m_published;
+    
+    void publishLayout()
+    {
+        auto& tiles = m_published.tiles;
+        auto monocle = (m_layoutMode == LayoutMode::MONOCLE) ? getMonocleLeaf() : nullptr;
+        bool changed = false;
+        size_t count = 0;
         
-        if (!parent)
+        auto publish = [&] (TileNode& leaf, const wayfire_toplevel_view& view)
         {
-            m_root = newSplit;
+            animated_tile::tile_goal_t entry{
+                view.get(),
+                leaf.geometry().goal(),
+                leaf.view() == view && (!monocle || monocle.get() == &leaf)
+            };
+            
+            if (count < tiles.size())
+            {
+                if (tiles[count] != entry)
+                {
+                    tiles[count] = entry;
+                    changed = true;
+                }
+            }
+            else
+            {
+                tiles.push_back(entry);
+                changed = true;
+            }
+            count++;
+        };
+        
+        if (m_root)
+        {
+            m_root->forEachNode([&] (TileNode& n)
+            {
+                if (!n.isLeaf())
+                    return;
+                if (n.isTabbed())
+                {
+                    for (auto& tab : n.tabs())
+                        publish(n, tab);
+                }
+                else if (n.view())
+                {
+                    publish(n, n.view());
+                }
+            });
         }
-        else
+        
+        if (tiles.size() != count)
         {
-            parent->setChild(existingChildIdx, newSplit);
+            tiles.resize(count);
+            changed = true;
         }
+        
+        if (changed)
+            m_published.generation++;
     }
-};
-
-// ============================================================================
-// View Animation Data - stored per-view for managing its animation
-// ============================================================================
-
-class ViewAnimData : public wf::custom_data_t
-{
-  public:
-    wf::geometry_t goalGeometry{0, 0, 100, 100};
-    std::shared_ptr<wf::scene::view_2d_transformer_t> transformer;
-    std::string transformerName;
-    bool isTiled = false;
-    bool isPseudotiled = false;
-    AnimationType currentAnimType = AnimationType::WINDOW_MOVE;
-    int workspaceIndex = -1;  // Which workspace tree this view belongs to
-};
-
-// ============================================================================
-// Drag State - tracks window drag operations for swapping
-// ============================================================================
-
-struct DragState
-{
-    wayfire_toplevel_view draggedView = nullptr;
-    TileNodePtr draggedNode = nullptr;
-    wf::geometry_t dragStartGeometry{0, 0, 0, 0};
-    wf::point_t dragStartCursor{0, 0};
-    bool isDragging = false;
-    int sourceWorkspaceIndex = -1;
     
-    // Visual feedback for drop target
-    TileNodePtr currentDropTarget = nullptr;
+    // Memoized layouts: everything a layout pass depends on, and the goal
+    // rectangle plus resolved split direction of every node in pre-order.
+    // The node generation stands in for the tree itself; the rest are the
+    // tree-wide settings the pass reads
+    struct LayoutKey
+    {
+        LayoutMode mode;
+        uint64_t generation;
+        const TileNode* monocle;
+        wf::geometry_t bounds;
+        int gapIn;
+        bool preserveSplit;
+        float splitWidthMultiplier;
+        wf::pointf_t pseudoAlign;
+        
+        bool operator==(const LayoutKey& o) const
+        {
+            return mode == o.mode && generation == o.generation && monocle == o.monocle &&
+                bounds == o.bounds && gapIn == o.gapIn && preserveSplit == o.preserveSplit &&
+                splitWidthMultiplier == o.splitWidthMultiplier &&
+                pseudoAlign.x == o.pseudoAlign.x && pseudoAlign.y == o.pseudoAlign.y;
+        }
+    };
     
-    void reset()
+    struct LayoutCacheEntry
     {
-        draggedView = nullptr;
-        draggedNode = nullptr;
-        dragStartGeometry = {0, 0, 0, 0};
-        dragStartCursor = {0, 0};
-        isDragging = false;
-        sourceWorkspaceIndex = -1;
-        currentDropTarget = nullptr;
+        LayoutKey key;
+        std::vector<wf::geometry_t> goals;
+        std::vector<SplitDir> dirs;
+    };
+    
+    static constexpr size_t LAYOUT_CACHE_SIZE = 8;
+    std::list<LayoutCacheEntry> m_layoutCache;  // Front = most recently used
+    
+    LayoutKey makeLayoutKey(wf::geometry_t bounds) const
+    {
+        auto monocle = (m_layoutMode == LayoutMode::MONOCLE) ? getMonocleLeaf() : nullptr;
+        return LayoutKey{m_layoutMode, TileNode::inputGeneration(), monocle.get(), bounds,
+            m_gapIn, m_preserveSplit, m_splitWidthMultiplier, m_pseudoAlign};
     }
-};
-
-// ============================================================================
-// Main Plugin
-// ============================================================================
-
-class AnimatedTilePlugin : public wf::per_output_plugin_instance_t
-{
-  public:
-    // Basic configuration
-    wf::option_wrapper_t<int> opt_duration{"animated-tile/duration"};
-    wf::option_wrapper_t<bool> opt_tile_by_default{"animated-tile/tile_by_default"};
     
-    // Default bezier curve (used as fallback)
-    wf::option_wrapper_t<double> opt_bezier_p1_x{"animated-tile/bezier_p1_x"};
-    wf::option_wrapper_t<double> opt_bezier_p1_y{"animated-tile/bezier_p1_y"};
-    wf::option_wrapper_t<double> opt_bezier_p2_x{"animated-tile/bezier_p2_x"};
-    wf::option_wrapper_t<double> opt_bezier_p2_y{"animated-tile/bezier_p2_y"};
+    bool applyCachedLayout(const LayoutKey& key, bool animate)
+    {
+        auto it = std::find_if(m_layoutCache.begin(), m_layoutCache.end(),
+            [&key] (const LayoutCacheEntry& e) { return e.key == key; });
+        if (it == m_layoutCache.end())
+            return false;
+        
+        m_layoutCache.splice(m_layoutCache.begin(), m_layoutCache, it);
+        
+        // Same generation, same tree: the entry has one slot per node
+        size_t i = 0;
+        m_root->forEachNode([&] (TileNode& n)
+        {
+            n.restoreSplitDir(it->dirs[i]);
+            n.geometry().setGoal(it->goals[i], animate);
+            i++;
+        });
+        return true;
+    }
     
-    // Hyprland-style options
-    wf::option_wrapper_t<int> opt_gaps_in{"animated-tile/gaps_in"};
-    wf::option_wrapper_t<int> opt_gaps_out{"animated-tile/gaps_out"};
-    wf::option_wrapper_t<bool> opt_preserve_split{"animated-tile/preserve_split"};
-    wf::option_wrapper_t<double> opt_split_width_multiplier{"animated-tile/split_width_multiplier"};
-    wf::option_wrapper_t<int> opt_force_split{"animated-tile/force_split"};
-    wf::option_wrapper_t<bool> opt_smart_split{"animated-tile/smart_split"};
-    wf::option_wrapper_t<double> opt_popin_percent{"animated-tile/popin_percent"};
+    void storeLayout(const LayoutKey& key)
+    {
+        LayoutCacheEntry entry{key, {}, {}};
+        m_root->forEachNode([&entry] (TileNode& n)
+        {
+            entry.goals.push_back(n.geometry().goal());
+            entry.dirs.push_back(n.splitDir());
+        });
+        
+        m_layoutCache.push_front(std::move(entry));
+        if (m_layoutCache.size() > LAYOUT_CACHE_SIZE)
+            m_layoutCache.pop_back();
+    }
     
-    // Drag-to-swap options
-    wf::option_wrapper_t<bool> opt_enable_drag_swap{"animated-tile/enable_drag_swap"};
-    wf::option_wrapper_t<int> opt_drag_threshold{"animated-tile/drag_threshold"};
+    wayfire_toplevel_view m_focusedView = nullptr;
+    wf::point_t m_cursorPos{0, 0};
     
-    // Max windows per workspace (0 = unlimited)
-    wf::option_wrapper_t<int> opt_max_windows_per_workspace{"animated-tile/max_windows_per_workspace"};
+    // Pending preselection for the next inserted window
+    struct Preselection
+    {
+        TileNodeWeak leaf;
+        SplitDir dir;
+        bool newFirst;
+        float ratio;  // Share of the new window
+    };
+    std::optional<Preselection> m_preselect;
     
-    // Separate animation durations (like Hyprland)
-    wf::option_wrapper_t<int> opt_duration_in{"animated-tile/duration_in"};
-    wf::option_wrapper_t<int> opt_duration_out{"animated-tile/duration_out"};
-    wf::option_wrapper_t<int> opt_duration_move{"animated-tile/duration_move"};
+    // Preselected leaf, if it still holds a view of this tree
+    TileNodePtr validPreselectLeaf() const
+    {
+        if (!m_preselect)
+            return nullptr;
+        
+        auto leaf = m_preselect->leaf.lock();
+        if (!leaf || !leaf->view() || lookupLeaf(leaf->view()) != leaf)
+            return nullptr;
+        return leaf;
+    }
     
-    // Separate bezier curves for windowsIn (0 = use default)
-    wf::option_wrapper_t<double> opt_bezier_in_p1_x{"animated-tile/bezier_in_p1_x"};
-    wf::option_wrapper_t<double> opt_bezier_in_p1_y{"animated-tile/bezier_in_p1_y"};
-    wf::option_wrapper_t<double> opt_bezier_in_p2_x{"animated-tile/bezier_in_p2_x"};
-    wf::option_wrapper_t<double> opt_bezier_in_p2_y{"animated-tile/bezier_in_p2_y"};
+    struct ResolvedPreselection
+    {
+        TileNodePtr leaf;
+        SplitDir dir;
+        bool newFirst;
+        float ratio;
+    };
     
-    // Separate bezier curves for windowsOut
-    wf::option_wrapper_t<double> opt_bezier_out_p1_x{"animated-tile/bezier_out_p1_x"};
-    wf::option_wrapper_t<double> opt_bezier_out_p1_y{"animated-tile/bezier_out_p1_y"};
-    wf::option_wrapper_t<double> opt_bezier_out_p2_x{"animated-tile/bezier_out_p2_x"};
-    wf::option_wrapper_t<double> opt_bezier_out_p2_y{"animated-tile/bezier_out_p2_y"};
+    std::optional<ResolvedPreselection> peekPreselection() const
+    {
+        auto leaf = validPreselectLeaf();
+        if (!leaf)
+            return std::nullopt;
+        return ResolvedPreselection{leaf, m_preselect->dir, m_preselect->newFirst, m_preselect->ratio};
+    }
     
-    // Separate bezier curves for windowsMove (resize/reposition)
-    wf::option_wrapper_t<double> opt_bezier_move_p1_x{"animated-tile/bezier_move_p1_x"};
-    wf::option_wrapper_t<double> opt_bezier_move_p1_y{"animated-tile/bezier_move_p1_y"};
-    wf::option_wrapper_t<double> opt_bezier_move_p2_x{"animated-tile/bezier_move_p2_x"};
-    wf::option_wrapper_t<double> opt_bezier_move_p2_y{"animated-tile/bezier_move_p2_y"};
+    // O(1) view -> leaf lookup, kept in sync by add/remove/swap
+    std::unordered_map<wf::toplevel_view_interface_t*, TileNodeWeak> m_leafIndex;
     
-    void init() override
+    // MRU focus history of views in this tree (front = most recent)
+    std::list<wayfire_toplevel_view> m_focusHistory;
+    std::unordered_map<wf::toplevel_view_interface_t*,
+        std::list<wayfire_toplevel_view>::iterator> m_focusHistoryPos;
+    
+    std::vector<SwallowPair> m_parkedSwallows;
+    
+    TileNodePtr lookupLeaf(wayfire_toplevel_view view) const
     {
-        // Setup bezier curves for different animation types
-        updateAnimationConfigs();
+        auto it = m_leafIndex.find(view.get());
+        return (it != m_leafIndex.end()) ? it->second.lock() : nullptr;
+    }
+    
+    // Move a view of this tree to the front of the focus history
+    void touchFocusHistory(wayfire_toplevel_view view)
+    {
+        if (!view || !hasView(view))
+            return;
         
-        // Get workspace bounds
-        updateWorkspaceBounds();
+        auto it = m_focusHistoryPos.find(view.get());
+        if (it != m_focusHistoryPos.end())
+        {
+            m_focusHistory.splice(m_focusHistory.begin(), m_focusHistory, it->second);
+        }
+        else
+        {
+            m_focusHistory.push_front(view);
+            m_focusHistoryPos[view.get()] = m_focusHistory.begin();
+        }
+    }
+    
+    void forgetFocusHistory(wayfire_toplevel_view view)
+    {
+        auto it = m_focusHistoryPos.find(view.get());
+        if (it == m_focusHistoryPos.end())
+            return;
         
-        // Connect signals
-        output->connect(&on_view_mapped);
-        output->connect(&on_view_unmapped);
-        output->connect(&on_workarea_changed);
-        output->connect(&on_workspace_changed);
-        output->connect(&on_view_focused);
+        m_focusHistory.erase(it->second);
+        m_focusHistoryPos.erase(it);
+    }
+    
+    // Removed views leave the history immediately, so the front entry is
+    // always a surviving leaf
+    TileNodePtr getMostRecentLeaf() const
+    {
+        if (m_focusHistory.empty())
+            return nullptr;
+        return lookupLeaf(m_focusHistory.front());
+    }
+    
+    // Determine split direction based on Hyprland rules
+    SplitDir determineSplitDirection(wf::geometry_t bounds, TileNodePtr existingNode)
+    {
+        if (m_smartSplit && existingNode)
+        {
+            // Smart split: based on cursor position relative to window center
+            auto nodeGeo = existingNode->geometry().goal();
+            int centerX = nodeGeo.x + nodeGeo.width / 2;
+            int centerY = nodeGeo.y + nodeGeo.height / 2;
+            
+            int dx = std::abs(m_cursorPos.x - centerX);
+            int dy = std::abs(m_cursorPos.y - centerY);
+            
+            // Normalize by dimensions
+            float relX = static_cast<float>(dx) / (nodeGeo.width / 2);
+            float relY = static_cast<float>(dy) / (nodeGeo.height / 2);
+            
+            return (relX > relY) ? SplitDir::HORIZONTAL : SplitDir::VERTICAL;
+        }
         
-        // Connect move request for drag-to-swap
-        output->connect(&on_move_request);
+        // Default: aspect ratio based (Hyprland default behavior)
+        float effectiveWidth = bounds.width * m_splitWidthMultiplier;
+        return (effectiveWidth > bounds.height) ? SplitDir::HORIZONTAL : SplitDir::VERTICAL;
+    }
+    
+    // Whether splitting `leaf` for a new window keeps both tiles at or above
+    // the minimum tile size
+    bool splitFits(const TileNodePtr& leaf, const std::optional<ResolvedPreselection>& preselect)
+    {
+        if (m_minTileWidth <= 0 && m_minTileHeight <= 0)
+            return true;
         
-        // Connect to core for pointer events during drag
-        wf::get_core().connect(&on_pointer_motion);
-        wf::get_core().connect(&on_pointer_button);
+        auto geo = leaf->geometry().goal();
+        SplitDir dir = preselect ? preselect->dir : determineSplitDirection(geo, leaf);
+        float share = preselect ? std::min(preselect->ratio, 1.0f - preselect->ratio) : 0.5f;
         
-        // Start animation tick loop
-        m_animationActive = false;
+        if (dir == SplitDir::HORIZONTAL)
+        {
+            int width = static_cast<int>((geo.width - m_gapIn) * share);
+            return width >= m_minTileWidth && geo.height >= m_minTileHeight;
+        }
+        
+        int height = static_cast<int>((geo.height - m_gapIn) * share);
+        return height >= m_minTileHeight && geo.width >= m_minTileWidth;
     }
     
-    void fini() override
+    // Calculate starting geometry for new window (for smooth animation)
+    wf::geometry_t calculateNewWindowStart(wf::geometry_t bounds, SplitDir dir, bool newOnLeft)
     {
-        // End any active grab
-        end_grab();
-        
-        // Remove all transformers from all trees
-        for (auto& [wsIndex, tree] : m_trees)
+        if (dir == SplitDir::HORIZONTAL)
         {
-            for (auto& view : tree->getViews())
+            int halfWidth = bounds.width / 2;
+            if (newOnLeft)
+            {
+                return {bounds.x, bounds.y, halfWidth, bounds.height};
+            }
+            else
             {
-                removeTransformer(view);
+                return {bounds.x + halfWidth, bounds.y, halfWidth, bounds.height};
+            }
+        }
+        else
+        {
+            int halfHeight = bounds.height / 2;
+            if (newOnLeft)
+            {
+                return {bounds.x, bounds.y, bounds.width, halfHeight};
+            }
+            else
+            {
+                return {bounds.x, bounds.y + halfHeight, bounds.width, halfHeight};
             }
         }
+    }
+    
+    // Find the deepest, rightmost leaf (fallback for dwindle style)
+    TileNodePtr findLastLeaf(TileNodePtr node)
+    {
+        if (!node)
+            return nullptr;
+        if (node->isLeaf())
+            return node;
+        
+        // In dwindle, prefer the last child (that's where new windows typically go)
+        for (int i = node->childCount() - 1; i >= 0; i--)
+        {
+            auto found = findLastLeaf(node->child(i));
+            if (found)
+                return found;
+        }
+        
+        return nullptr;
+    }
+    
+    // Give every child a share proportional to its leaf count, so leaves
+    // along a run of same-direction splits end up the same size; returns
+    // the leaf count
+    static int equalizeNode(const TileNodePtr& node)
+    {
+        if (!node)
+            return 0;
+        if (node->isLeaf())
+            return 1;
+        
+        std::vector<float> weights;
+        int total = 0;
+        for (auto& c : node->children())
+        {
+            int leaves = std::max(1, equalizeNode(c));
+            weights.push_back(static_cast<float>(leaves));
+            total += leaves;
+        }
+        
+        node->setWeights(std::move(weights));
+        return total;
+    }
+    
+    // Rotate one container 90 degrees clockwise: left|right becomes
+    // left-over-right, top-over-bottom becomes bottom|top. The direction is
+    // locked so the aspect-ratio heuristic does not undo the rotation, and
+    // stays locked afterwards like a togglesplit
+    static void rotateNode(TileNode& n)
+    {
+        if (n.isLeaf())
+            return;
+        
+        if (n.splitDir() == SplitDir::HORIZONTAL)
+        {
+            n.setSplitDir(SplitDir::VERTICAL);
+        }
+        else
+        {
+            n.setSplitDir(SplitDir::HORIZONTAL);
+            n.reverseChildren();
+        }
+        n.setSplitLocked(true);
+    }
+    
+    // Convert binary -> n-ary: a split whose child splits in the same
+    // direction absorbs that child's children, scaling their weights by the
+    // child's share. Like rotate, a merged container's direction is locked,
+    // so the layout is unchanged even without preserve_split.
+    void flattenNode(TileNodePtr node)
+    {
+        if (!node || node->isLeaf())
+            return;
+        
+        for (auto& c : node->children())
+            flattenNode(c);
+        
+        std::vector<TileNodePtr> children;
+        std::vector<float> weights;
+        bool merged = false;
+        for (int i = 0; i < node->childCount(); i++)
+        {
+            auto c = node->child(i);
+            float w = node->weight(i);
+            if (c && !c->isLeaf() && c->splitDir() == node->splitDir())
+            {
+                for (int j = 0; j < c->childCount(); j++)
+                {
+                    children.push_back(c->child(j));
+                    weights.push_back(w * c->weight(j));
+                }
+                merged = true;
+            }
+            else
+            {
+                children.push_back(c);
+                weights.push_back(w);
+            }
+        }
+        
+        if (merged)
+        {
+            node->adoptChildren(std::move(children), std::move(weights));
+            node->setSplitLocked(true);
+        }
+    }
+    
+    // Convert n-ary -> binary: a container of N children becomes a chain
+    // of nested two-way splits with equivalent ratios, for commands that
+    // assume a binary tree
+    void binarizeNode(TileNodePtr node)
+    {
+        if (!node || node->isLeaf())
+            return;
+        
+        while (node->childCount() > 2)
+        {
+            // Fold the last two children into one nested split
+            int n = node->childCount();
+            auto a = node->child(n - 2);
+            auto b = node->child(n - 1);
+            float wa = node->weight(n - 2);
+            float wb = node->weight(n - 1);
+            
+            auto nested = TileNode::createSplit(node->splitDir(), a, b);
+            nested->setConfig(m_curve, m_durationMs);
+            nested->setSplitRatio(wa / std::max(wa + wb, 0.0001f));
+            nested->setSplitLocked(node->isSplitLocked());
+            nested->geometry() = node->geometry();
+            
+            std::vector<TileNodePtr> children(node->children().begin(),
+                node->children().end() - 2);
+            std::vector<float> weights(node->weights().begin(), node->weights().end() - 2);
+            children.push_back(nested);
+            weights.push_back(wa + wb);
+            node->adoptChildren(std::move(children), std::move(weights));
+        }
+        
+        for (auto& c : node->children())
+            binarizeNode(c);
+    }
+    
+    // Insert newLeaf by splitting existingLeaf
+    void insertAtLeaf(TileNodePtr existingLeaf, TileNodePtr newLeaf)
+    {
+        // Determine split direction
+        auto existingGeo = existingLeaf->geometry().goal();
+        SplitDir dir = determineSplitDirection(existingGeo, existingLeaf);
+        
+        // Calculate starting position for new leaf
+        wf::geometry_t newLeafStart;
+        bool newOnRight = (m_forceSplit != 1);  // Default is right/bottom
+        
+        if (m_forceSplit == 0 && m_smartSplit)
+        {
+            // Use cursor position to determine side
+            int centerX = existingGeo.x + existingGeo.width / 2;
+            int centerY = existingGeo.y + existingGeo.height / 2;
+            
+            if (dir == SplitDir::HORIZONTAL)
+            {
+                newOnRight = (m_cursorPos.x > centerX);
+            }
+            else
+            {
+                newOnRight = (m_cursorPos.y > centerY);
+            }
+        }
+        
+        newLeafStart = calculateNewWindowStart(existingGeo, dir, !newOnRight);
+        newLeaf->geometry().warp(newLeafStart);
+        
+        insertSplit(existingLeaf, newLeaf, dir, newOnRight, m_naryContainers);
+    }
+    
+    // Put newLeaf next to existingLeaf in the given direction and return the
+    // split node holding both
+    TileNodePtr insertSplit(TileNodePtr existingLeaf, TileNodePtr newLeaf,
+                            SplitDir dir, bool newOnRight, bool allowNary)
+    {
+        auto parent = existingLeaf->parent();
+        int existingChildIdx = existingLeaf->childIndex();
+        
+        // N-ary mode: if the parent already splits in this direction, join
+        // it as a sibling taking half of the existing leaf's share instead
+        // of nesting another two-way split
+        if (allowNary && parent && parent->splitDir() == dir)
+        {
+            int idx = newOnRight ? existingChildIdx + 1 : existingChildIdx;
+            parent->insertChildSplitting(idx, newLeaf, existingChildIdx);
+            return parent;
+        }
+        
+        // Create split with appropriate child order
+        TileNodePtr first, second;
+        if (newOnRight)
+        {
+            first = existingLeaf;
+            second = newLeaf;
+        }
+        else
+        {
+            first = newLeaf;
+            second = existingLeaf;
+        }
+        
+        auto newSplit = TileNode::createSplit(dir, first, second);
+        newSplit->setConfig(m_curve, m_durationMs);
+        
+        if (!parent)
+        {
+            m_root = newSplit;
+        }
+        else
+        {
+            parent->setChild(existingChildIdx, newSplit);
+        }
+        
+        return newSplit;
+    }
+};
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+// Split a whitespace/comma separated option value into its entries
+inline std::vector<std::string> splitList(const std::string& value)
+{
+    std::vector<std::string> out;
+    std::string item;
+    for (char c : value)
+    {
+        if (std::isspace(static_cast<unsigned char>(c)) || c == ',')
+        {
+            if (!item.empty())
+                out.push_back(item);
+            item.clear();
+        }
+        else
+        {
+            item += c;
+        }
+    }
+    if (!item.empty())
+        out.push_back(item);
+    return out;
+}
+
+inline std::string toLower(std::string s)
+{
+    for (auto& c : s)
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return s;
+}
+
+// Parse "1:monocle 2:dwindle 5:grid" into a layout policy; malformed or
+// unknown entries are skipped
+inline LayoutPolicy parseLayoutPolicy(const std::string& value)
+{
+    static const std::map<std::string, LayoutMode> modes = {
+        {"dwindle", LayoutMode::DWINDLE},
+        {"monocle", LayoutMode::MONOCLE},
+        {"grid", LayoutMode::GRID},
+    };
+    
+    LayoutPolicy policy;
+    for (auto& entry : splitList(value))
+    {
+        auto colon = entry.find(':');
+        if (colon == std::string::npos)
+            continue;
+        
+        auto mode = modes.find(toLower(entry.substr(colon + 1)));
+        int minCount = std::atoi(entry.substr(0, colon).c_str());
+        if (mode == modes.end() || minCount < 1)
+            continue;
+        
+        policy.emplace_back(minCount, mode->second);
+    }
+    
+    std::sort(policy.begin(), policy.end(),
+        [] (const auto& a, const auto& b) { return a.first < b.first; });
+    return policy;
+}
+
+// Parse an alignment such as "center", "top", "bottom-right" into
+// fractions of the free space (0 = left/top, 1 = right/bottom)
+inline wf::pointf_t parseAlignment(const std::string& value)
+{
+    wf::pointf_t align{0.5, 0.5};
+    std::string words = value;
+    std::replace(words.begin(), words.end(), '-', ' ');
+    
+    for (auto& word : splitList(toLower(words)))
+    {
+        if (word == "left")
+            align.x = 0.0;
+        else if (word == "right")
+            align.x = 1.0;
+        else if (word == "top")
+            align.y = 0.0;
+        else if (word == "bottom")
+            align.y = 1.0;
+    }
+    return align;
+}
+
+// Parse "1 2 1" into relative zone widths, left to right; an empty or
+// malformed value gives a single zone spanning the workarea
+inline std::vector<float> parseZones(const std::string& value, size_t maxZones)
+{
+    std::vector<float> weights;
+    for (auto& entry : splitList(value))
+    {
+        float weight = std::strtof(entry.c_str(), nullptr);
+        if (weight > 0.0f && weights.size() < maxZones)
+            weights.push_back(weight);
+    }
+    
+    if (weights.empty())
+        weights.push_back(1.0f);
+    return weights;
+}
+
+// Parent process id from /proc/<pid>/stat, or -1 on failure
+inline pid_t getParentPid(pid_t pid)
+{
+    std::ifstream stat("/proc/" + std::to_string(pid) + "/stat");
+    std::string line;
+    if (!std::getline(stat, line))
+        return -1;
+    
+    // The command name may contain spaces and parentheses; fields resume
+    // after the last ')' as "<state> <ppid> ..."
+    auto close = line.rfind(')');
+    if (close == std::string::npos)
+        return -1;
+    
+    std::istringstream fields(line.substr(close + 1));
+    std::string state;
+    pid_t ppid = -1;
+    fields >> state >> ppid;
+    return fields ? ppid : -1;
+}
+
+// Path of a file in $XDG_RUNTIME_DIR, or empty without one; state and
+// traces are never written to a shared directory such as /tmp
+inline std::string runtimePath(const std::string& name)
+{
+    const char *dir = std::getenv("XDG_RUNTIME_DIR");
+    return (dir && *dir) ? std::string(dir) + "/" + name : std::string{};
+}
+
+// Replace the file at `path` with `contents`. The old file is unlinked and
+// the new one created exclusively, without following symlinks, so nothing
+// planted at the path can redirect the write
+inline bool writeFileExclusive(const std::string& path, const std::string& contents)
+{
+    if (path.empty())
+        return false;
+    
+    ::unlink(path.c_str());
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd < 0)
+        return false;
+    
+    size_t written = 0;
+    while (written < contents.size())
+    {
+        ssize_t n = ::write(fd, contents.data() + written, contents.size() - written);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        written += static_cast<size_t>(n);
+    }
+    return ::close(fd) == 0;
+}
+
+// ============================================================================
+// View Animation Data - stored per-view for managing its animation
+// ============================================================================
+
+class ViewAnimData : public wf::custom_data_t
+{
+  public:
+    wf::geometry_t goalGeometry{0, 0, 100, 100};
+    std::shared_ptr<wf::scene::view_2d_transformer_t> transformer;
+    std::string transformerName;
+    bool isTiled = false;
+    bool isPseudotiled = false;
+    AnimationType currentAnimType = AnimationType::WINDOW_MOVE;
+    int workspaceIndex = -1;  // Which workspace tree this view belongs to
+    int zone = 0;             // Zone of that workspace (see the zones option)
+    
+    // Last pixel-snapped state pushed to the transformer, used to skip
+    // damage for frames where the view did not move a physical pixel
+    GeometryF lastSnappedGeometry;
+    wf::geometry_t lastGoalGeometry{0, 0, 0, 0};
+    float lastScale = -1.0f;
+    float lastAlpha = -1.0f;
+    
+    // Terminal swallowing: the hidden terminal whose leaf this view took
+    // over, and on the terminal side the view currently swallowing it
+    wayfire_toplevel_view swallowedView = nullptr;
+    wayfire_toplevel_view swallowedBy = nullptr;
+    
+    // Scene node disabled because another tile is shown in monocle mode,
+    // or because this view is a background tab
+    bool hiddenByLayout = false;
+    
+    // Shown in the pinned column on every workspace instead of in a tree
+    bool pinned = false;
+};
+
+// ============================================================================
+// Parked Layouts - trees of outputs that went away, kept on the core until
+// the same output comes back
+// ============================================================================
+
+class ParkedLayouts : public wf::custom_data_t
+{
+  public:
+    // Output key -> tree key (workspace and zone) -> tree
+    std::map<std::string, std::map<int, std::shared_ptr<TileTree>>> trees;
+    
+    // Output key -> that output's pinned column, top to bottom
+    std::map<std::string, std::vector<wayfire_toplevel_view>> pinned;
+    
+    ParkedLayouts()
+    {
+        wf::get_core().connect(&on_view_unmapped);
+    }
+    
+    // Stable key for an output: its EDID identity when known, so a monitor
+    // is recognized on any connector, else the connector name
+    static std::string outputKey(wf::output_t *output)
+    {
+        auto handle = output->handle;
+        if (handle->serial && *handle->serial)
+        {
+            return std::string(handle->make ? handle->make : "") + " " +
+                (handle->model ? handle->model : "") + " " + handle->serial;
+        }
+        return handle->name;
+    }
+    
+    // Plugin reload: the registry (which by then holds every output's trees)
+    // is written to a runtime file that the next plugin instance reads
+    // back, since nothing of this plugin's code survives the unload
+    static std::string snapshotPath()
+    {
+        return runtimePath("wayfire-animated-tile-" + std::to_string(getpid()) + ".state");
+    }
+    
+    void save() const
+    {
+        std::ostringstream out;
+        for (auto& [key, outputTrees] : trees)
+        {
+            for (auto& [treeKey, tree] : outputTrees)
+            {
+                out << "tree " << treeKey << " " << key << "\n";
+                tree->serialize(out);
+            }
+        }
+        
+        for (auto& [key, views] : pinned)
+        {
+            for (auto& view : views)
+                out << "pin " << TileTree::viewId(view) << " " << key << "\n";
+        }
+        
+        if (!trees.empty() || !pinned.empty())
+            writeFileExclusive(snapshotPath(), out.str());
+    }
+    
+    // Load a snapshot left by the previous plugin instance, if any, into
+    // the registry; views are re-bound by TileTree::viewId(). The file is
+    // consumed: it is removed even if it turns out to be unreadable
+    static void restore()
+    {
+        auto path = snapshotPath();
+        if (path.empty())
+            return;
+        
+        std::ifstream in(path);
+        if (!in)
+            return;
+        std::remove(path.c_str());
+        
+        std::unordered_map<uint64_t, wayfire_toplevel_view> views;
+        for (auto& view : wf::get_core().get_all_views())
+        {
+            auto toplevel = wf::toplevel_cast(view);
+            if (toplevel && toplevel->is_mapped())
+                views[TileTree::viewId(toplevel)] = toplevel;
+        }
+        
+        auto lookup = [&views] (uint64_t id) -> wayfire_toplevel_view
+        {
+            auto it = views.find(id);
+            return (it != views.end()) ? it->second : nullptr;
+        };
+        
+        auto parked = wf::get_core().get_data_safe<ParkedLayouts>();
+        std::string tag;
+        while (in >> tag)
+        {
+            // "tree <key> <output>" followed by the tree, or a pinned window
+            // as "pin <view id> <output>"
+            uint64_t id = 0;
+            int treeKey = 0;
+            bool read = (tag == "pin") ? bool(in >> id) : (tag == "tree") && (in >> treeKey);
+            if (!read)
+                break;
+            
+            std::string key;
+            std::getline(in, key);
+            key.erase(0, key.find_first_not_of(' '));
+            
+            if (tag == "pin")
+            {
+                if (auto view = lookup(id))
+                    parked->pinned[key].push_back(view);
+                continue;
+            }
+            
+            auto tree = TileTree::deserialize(in, lookup);
+            if (!tree)
+                break;
+            if (!tree->isEmpty())
+                parked->trees[key][treeKey] = std::move(tree);
+        }
+    }
+    
+  private:
+    // Windows closed while their output is away leave the parked tree
+    wf::signal::connection_t<wf::view_unmapped_signal> on_view_unmapped =
+        [this] (wf::view_unmapped_signal *ev)
+    {
+        auto view = wf::toplevel_cast(ev->view);
+        if (!view)
+            return;
+        
+        for (auto& [key, outputTrees] : trees)
+        {
+            for (auto& [wsIndex, tree] : outputTrees)
+                tree->removeView(view, false);
+        }
+        
+        for (auto& [key, views] : pinned)
+            views.erase(std::remove(views.begin(), views.end(), view), views.end());
+    };
+};
+
+// ============================================================================
+// Output Spanning - outputs listed in span_outputs tile as one surface
+// ============================================================================
+
+// The member outputs' workareas side by side in layout order, with `bezel`
+// pixels of invisible surface between neighbours so a window crossing the
+// seam lines up across the physical bezel. All members share the same
+// trees, laid out in these virtual coordinates; each one applies geometry
+// only to the views whose tile lies on its output. A view lives on one
+// output, so a tile straddling a seam goes to the member holding its
+// center and the part beyond the seam is not shown
+class SpanGroup : public wf::custom_data_t
+{
+  public:
+    struct Member
+    {
+        wf::output_t *output;
+        std::function<void()> kick;       // Start the member's animation loop
+        std::function<void()> resize;     // Re-read the member's own bounds
+        std::function<void()> relayout;   // Lay out the shared trees once
+        std::function<void(int)> share;   // A tree was added under this key
+    };
+    
+    std::vector<Member> members;  // Left to right
+    std::map<int, std::shared_ptr<TileTree>> trees;
+    int bezel = 0;
+    
+    void join(Member member)
+    {
+        members.push_back(std::move(member));
+        for (auto& [key, tree] : trees)
+            members.back().share(key);
+        
+        std::sort(members.begin(), members.end(), [] (const Member& a, const Member& b)
+        {
+            return a.output->get_layout_geometry().x < b.output->get_layout_geometry().x;
+        });
+        resizeAll();
+    }
+    
+    void leave(wf::output_t *output)
+    {
+        members.erase(std::remove_if(members.begin(), members.end(),
+            [output] (const Member& m) { return m.output == output; }), members.end());
+        
+        // The last member parks or tears down the trees itself
+        if (members.empty())
+            trees.clear();
+        resizeAll();
+    }
+    
+    // Add a tree to every member (an existing tree under the key wins)
+    void addTree(int key, std::shared_ptr<TileTree> tree)
+    {
+        if (trees.count(key))
+            return;
+        
+        trees[key] = std::move(tree);
+        for (auto& m : members)
+            m.share(key);
+    }
+    
+    // Where an output's workarea lies on the virtual surface; all members
+    // get the height of the shortest one
+    wf::geometry_t rectOf(wf::output_t *output) const
+    {
+        wf::geometry_t rect{0, 0, 0, bounds().height};
+        for (auto& m : members)
+        {
+            rect.width = m.output->workarea->get_workarea().width;
+            if (m.output == output)
+                break;
+            rect.x += rect.width + bezel;
+        }
+        return rect;
+    }
+    
+    wf::geometry_t bounds() const
+    {
+        wf::geometry_t bounds{0, 0, 0, 0};
+        for (auto& m : members)
+        {
+            auto workarea = m.output->workarea->get_workarea();
+            if (bounds.width > 0)
+                bounds.width += bezel;
+            bounds.width += workarea.width;
+            bounds.height = (bounds.height > 0)
+                ? std::min(bounds.height, workarea.height) : workarea.height;
+        }
+        return bounds;
+    }
+    
+    // The output a tile belongs to: the one its center is on, with the
+    // bezel split between its two neighbours
+    wf::output_t* ownerOf(wf::geometry_t goal) const
+    {
+        int center = goal.x + goal.width / 2;
+        for (size_t i = 0; i + 1 < members.size(); i++)
+        {
+            auto rect = rectOf(members[i].output);
+            if (center < rect.x + rect.width + bezel / 2)
+                return members[i].output;
+        }
+        return members.empty() ? nullptr : members.back().output;
+    }
+    
+    void kickAll()
+    {
+        for (auto& m : members)
+            m.kick();
+    }
+    
+    // Every member takes the new bounds, but the trees are shared, so only
+    // one lays them out and the others just animate
+    void resizeAll()
+    {
+        if (members.empty())
+            return;
+        
+        for (auto& m : members)
+            m.resize();
+        members.front().relayout();
+        kickAll();
+    }
+};
+
+// ============================================================================
+// Rect Overlay Node - draws a batch of solid rectangles in a single pass
+// ============================================================================
+
+struct OverlayRect
+{
+    wf::geometry_t geometry;
+    wf::color_t color;
+    
+    bool operator==(const OverlayRect& o) const
+    {
+        return geometry == o.geometry && color.r == o.color.r &&
+            color.g == o.color.g && color.b == o.color.b && color.a == o.color.a;
+    }
+    
+    bool operator!=(const OverlayRect& o) const { return !(*this == o); }
+};
+
+class RectOverlayNode : public wf::scene::node_t
+{
+  public:
+    RectOverlayNode() : node_t(false) {}
+    
+    const std::vector<OverlayRect>& rects() const { return m_rects; }
+    
+    // Replace the rectangles, damaging only the ones that changed (old
+    // and new area); callers keep rectangles in a stable order so that
+    // unchanged ones line up by index
+    void setRects(std::vector<OverlayRect> rects)
+    {
+        swapRects(rects);
+    }
+    
+    // Same, but hands the previous rectangles back in `rects`, so a caller
+    // that rebuilds often can reuse both buffers
+    void swapRects(std::vector<OverlayRect>& rects)
+    {
+        wf::region_t damage;
+        size_t common = std::min(m_rects.size(), rects.size());
+        for (size_t i = 0; i < common; i++)
+        {
+            if (m_rects[i] != rects[i])
+            {
+                damage |= m_rects[i].geometry;
+                damage |= rects[i].geometry;
+            }
+        }
+        
+        for (size_t i = common; i < m_rects.size(); i++)
+            damage |= m_rects[i].geometry;
+        for (size_t i = common; i < rects.size(); i++)
+            damage |= rects[i].geometry;
+        
+        std::swap(m_rects, rects);
+        if (!damage.empty())
+            wf::scene::damage_node(shared_from_this(), damage);
+    }
+    
+    void gen_render_instances(std::vector<wf::scene::render_instance_uptr>& instances,
+                              wf::scene::damage_callback push_damage,
+                              wf::output_t *shown_on) override;
+    
+    wf::geometry_t get_bounding_box() override
+    {
+        if (m_rects.empty())
+            return {0, 0, 0, 0};
+        
+        int x1 = INT32_MAX, y1 = INT32_MAX, x2 = INT32_MIN, y2 = INT32_MIN;
+        for (auto& r : m_rects)
+        {
+            x1 = std::min(x1, r.geometry.x);
+            y1 = std::min(y1, r.geometry.y);
+            x2 = std::max(x2, r.geometry.x + r.geometry.width);
+            y2 = std::max(y2, r.geometry.y + r.geometry.height);
+        }
+        return {x1, y1, x2 - x1, y2 - y1};
+    }
+    
+    std::string stringify() const override { return "animated-tile overlay"; }
+    
+  private:
+    std::vector<OverlayRect> m_rects;
+};
+
+class RectOverlayRenderInstance :
+    public wf::scene::simple_render_instance_t<RectOverlayNode>
+{
+  public:
+    using simple_render_instance_t::simple_render_instance_t;
+    
+    void render(const wf::render_target_t& target, const wf::region_t& region) override
+    {
+        OpenGL::render_begin(target);
+        for (auto& box : region)
+        {
+            target.logic_scissor(wlr_box_from_pixman_box(box));
+            for (auto& r : self->rects())
+            {
+                OpenGL::render_rectangle(r.geometry, r.color,
+                    target.get_orthographic_projection());
+            }
+        }
+        OpenGL::render_end();
+    }
+};
+
+inline void RectOverlayNode::gen_render_instances(
+    std::vector<wf::scene::render_instance_uptr>& instances,
+    wf::scene::damage_callback push_damage, wf::output_t *shown_on)
+{
+    instances.push_back(std::make_unique<RectOverlayRenderInstance>(this, push_damage, shown_on));
+}
+
+// Draw a non-negative number as seven-segment digits of 8x14 pixels, so
+// overlays can show figures without a text renderer; returns the width
+// used. A negative value draws a dash
+inline int appendSevenSegment(std::vector<OverlayRect>& rects, int value,
+    wf::point_t at, wf::color_t color)
+{
+    // Segments a-g as bits 0-6
+    static const uint8_t digits[10] = {
+        0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07, 0x7F, 0x6F
+    };
+    const int w = 8, h = 14, t = 2, advance = w + 3;
+    
+    std::string text = (value < 0) ? "-" : std::to_string(value);
+    int x = at.x;
+    for (char c : text)
+    {
+        uint8_t mask = (c == '-') ? 0x40 : digits[c - '0'];
+        wf::geometry_t segments[7] = {
+            {x, at.y, w, t},                      // a
+            {x + w - t, at.y, t, h / 2},          // b
+            {x + w - t, at.y + h / 2, t, h / 2},  // c
+            {x, at.y + h - t, w, t},              // d
+            {x, at.y + h / 2, t, h / 2},          // e
+            {x, at.y, t, h / 2},                  // f
+            {x, at.y + h / 2 - t / 2, w, t},      // g
+        };
+        for (int i = 0; i < 7; i++)
+        {
+            if (mask & (1 << i))
+                rects.push_back({segments[i], color});
+        }
+        x += advance;
+    }
+    return x - at.x;
+}
+
+// ============================================================================
+// Drag State - tracks window drag operations for swapping
+// ============================================================================
+
+struct DragState
+{
+    wayfire_toplevel_view draggedView = nullptr;
+    TileNodePtr draggedNode = nullptr;
+    wf::geometry_t dragStartGeometry{0, 0, 0, 0};
+    wf::point_t dragStartCursor{0, 0};
+    bool isDragging = false;
+    int sourceWorkspaceIndex = -1;
+    
+    // Visual feedback for drop target
+    TileNodePtr currentDropTarget = nullptr;
+    
+    void reset()
+    {
+        draggedView = nullptr;
+        draggedNode = nullptr;
+        dragStartGeometry = {0, 0, 0, 0};
+        dragStartCursor = {0, 0};
+        isDragging = false;
+        sourceWorkspaceIndex = -1;
+        currentDropTarget = nullptr;
+    }
+};
+
+// ============================================================================
+// Gesture State - tracks a touchpad swipe scrubbing a layout transition
+// ============================================================================
+
+struct GestureState
+{
+    enum class Action
+    {
+        NONE,          // Direction not decided yet
+        SWAP,          // Horizontal swipe: swap focused tile with its sibling
+        TOGGLE_SPLIT   // Vertical swipe: toggle the parent's split direction
+    };
+    
+    bool tracking = false;
+    Action action = Action::NONE;
+    TileTree* tree = nullptr;
+    TileNodePtr node = nullptr;     // Focused leaf at gesture start
+    TileNodePtr partner = nullptr;  // Swap partner or split parent
+    bool prevSplitLocked = false;
+    
+    wf::pointf_t delta{0.0, 0.0};
+    float sign = 1.0f;              // Initial swipe direction is "forward"
+    float progress = 0.0f;
+    float velocity = 0.0f;          // Progress per millisecond
+    uint32_t lastTimeMs = 0;
+    
+    void reset()
+    {
+        *this = GestureState{};
+    }
+};
+
+// ============================================================================
+// Flight Recorder - the last few seconds of plugin events and frame timings
+// in a fixed ring, always on; written out when a frame stutters or on IPC
+// request (animated-tile/dump-trace)
+// ============================================================================
+
+enum class TraceEvent : uint8_t
+{
+    FRAME,           // a = tick time (us), b = interval since last frame (us)
+    VIEW_MAPPED,
+    VIEW_UNMAPPED,
+    FOCUS,
+    WORKSPACE,       // a = new workspace index
+    WORKAREA,        // a, b = new workarea size
+    OUTPUT_CONFIG,   // a = changed fields
+    SUSPEND,
+    RESUME,
+    LAYOUT_MESSAGE,
+    GESTURE,         // a = 1 on begin, 0 on end; b = committed
+};
+
+inline const char* traceEventName(TraceEvent event)
+{
+    switch (event)
+    {
+      case TraceEvent::FRAME: return "frame";
+      case TraceEvent::VIEW_MAPPED: return "view-mapped";
+      case TraceEvent::VIEW_UNMAPPED: return "view-unmapped";
+      case TraceEvent::FOCUS: return "focus";
+      case TraceEvent::WORKSPACE: return "workspace";
+      case TraceEvent::WORKAREA: return "workarea";
+      case TraceEvent::OUTPUT_CONFIG: return "output-config";
+      case TraceEvent::SUSPEND: return "suspend";
+      case TraceEvent::RESUME: return "resume";
+      case TraceEvent::LAYOUT_MESSAGE: return "layout-message";
+      case TraceEvent::GESTURE: return "gesture";
+    }
+    return "unknown";
+}
+
+class FlightRecorder
+{
+  public:
+    // About 4 seconds of frames at 240 Hz, plus events
+    static constexpr size_t CAPACITY = 4096;
+    
+    // Never allocates; safe to call from the frame hook
+    void record(TraceEvent event, int32_t a = 0, int32_t b = 0)
+    {
+        auto& rec = m_ring[m_next % CAPACITY];
+        rec.time = AnimClock::now();
+        rec.event = event;
+        rec.a = a;
+        rec.b = b;
+        m_next++;
+    }
+    
+    // Write the ring oldest first, timestamps in ms relative to the newest
+    bool dump(const std::string& path, const std::string& header) const
+    {
+        std::ostringstream out;
+        out << "# animated-tile flight recorder: " << header << "\n";
+        out << "# time_ms event a b\n";
+        
+        uint64_t count = std::min<uint64_t>(m_next, CAPACITY);
+        if (count == 0)
+            return writeFileExclusive(path, out.str());
+        
+        auto newest = m_ring[(m_next - 1) % CAPACITY].time;
+        out << std::fixed << std::setprecision(3);
+        for (uint64_t i = m_next - count; i < m_next; i++)
+        {
+            auto& rec = m_ring[i % CAPACITY];
+            double ms = std::chrono::duration<double, std::milli>(rec.time - newest).count();
+            out << ms << " " << traceEventName(rec.event) << " " << rec.a << " " << rec.b << "\n";
+        }
+        return writeFileExclusive(path, out.str());
+    }
+    
+  private:
+    struct Record
+    {
+        AnimClock::time_point time;
+        TraceEvent event;
+        int32_t a;
+        int32_t b;
+    };
+    
+    std::array<Record, CAPACITY> m_ring{};
+    uint64_t m_next = 0;
+};
+
+// ============================================================================
+// Main Plugin
+// ============================================================================
+
+class AnimatedTilePlugin : public wf::per_output_plugin_instance_t
+{
+  public:
+    // Basic configuration
+    wf::option_wrapper_t<int> opt_duration{"animated-tile/duration"};
+    wf::option_wrapper_t<bool> opt_tile_by_default{"animated-tile/tile_by_default"};
+    
+    // Default bezier curve (used as fallback)
+    wf::option_wrapper_t<double> opt_bezier_p1_x{"animated-tile/bezier_p1_x"};
+    wf::option_wrapper_t<double> opt_bezier_p1_y{"animated-tile/bezier_p1_y"};
+    wf::option_wrapper_t<double> opt_bezier_p2_x{"animated-tile/bezier_p2_x"};
+    wf::option_wrapper_t<double> opt_bezier_p2_y{"animated-tile/bezier_p2_y"};
+    
+    // Hyprland-style options
+    wf::option_wrapper_t<int> opt_gaps_in{"animated-tile/gaps_in"};
+    wf::option_wrapper_t<int> opt_gaps_out{"animated-tile/gaps_out"};
+    wf::option_wrapper_t<bool> opt_preserve_split{"animated-tile/preserve_split"};
+    wf::option_wrapper_t<double> opt_split_width_multiplier{"animated-tile/split_width_multiplier"};
+    wf::option_wrapper_t<int> opt_force_split{"animated-tile/force_split"};
+    wf::option_wrapper_t<bool> opt_smart_split{"animated-tile/smart_split"};
+    wf::option_wrapper_t<bool> opt_nary_containers{"animated-tile/nary_containers"};
+    wf::option_wrapper_t<double> opt_popin_percent{"animated-tile/popin_percent"};
+    
+    // Terminal swallowing
+    wf::option_wrapper_t<bool> opt_swallow{"animated-tile/swallow"};
+    wf::option_wrapper_t<std::string> opt_swallow_terminals{"animated-tile/swallow_terminals"};
+    
+    // Automatic layout selection
+    wf::option_wrapper_t<std::string> opt_auto_layout{"animated-tile/auto_layout"};
+    
+    // Minimum tile size; smaller splits overflow into tabs
+    wf::option_wrapper_t<int> opt_min_tile_width{"animated-tile/min_tile_width"};
+    wf::option_wrapper_t<int> opt_min_tile_height{"animated-tile/min_tile_height"};
+    
+    // Pseudotiling
+    wf::option_wrapper_t<std::string> opt_pseudotile_align{"animated-tile/pseudotile_align"};
+    
+    // Plugins that suspend tiling while active
+    wf::option_wrapper_t<std::string> opt_suspend_for_plugins{"animated-tile/suspend_for_plugins"};
+    
+    // Zones
+    wf::option_wrapper_t<std::string> opt_zones{"animated-tile/zones"};
+    
+    // Output spanning
+    wf::option_wrapper_t<std::string> opt_span_outputs{"animated-tile/span_outputs"};
+    wf::option_wrapper_t<int> opt_span_bezel{"animated-tile/span_bezel"};
+    
+    // Pinned column
+    wf::option_wrapper_t<double> opt_pin_width{"animated-tile/pin_width"};
+    wf::option_wrapper_t<std::string> opt_pin_side{"animated-tile/pin_side"};
+    
+    // Flight recorder
+    wf::option_wrapper_t<int> opt_jank_threshold{"animated-tile/jank_threshold"};
+    
+    // Telemetry
+    wf::option_wrapper_t<bool> opt_telemetry{"animated-tile/telemetry"};
+    
+    // Drag-to-swap options
+    wf::option_wrapper_t<bool> opt_enable_drag_swap{"animated-tile/enable_drag_swap"};
+    wf::option_wrapper_t<int> opt_drag_threshold{"animated-tile/drag_threshold"};
+    
+    // Keybindings
+    wf::option_wrapper_t<wf::activatorbinding_t> opt_focus_last{"animated-tile/focus_last"};
+    wf::option_wrapper_t<wf::activatorbinding_t> opt_toggle_monocle{"animated-tile/toggle_monocle"};
+    wf::option_wrapper_t<wf::activatorbinding_t> opt_next_tab{"animated-tile/next_tab"};
+    wf::option_wrapper_t<wf::activatorbinding_t> opt_prev_tab{"animated-tile/prev_tab"};
+    wf::option_wrapper_t<wf::activatorbinding_t> opt_toggle_pseudotile{"animated-tile/toggle_pseudotile"};
+    wf::option_wrapper_t<wf::activatorbinding_t> opt_toggle_pin{"animated-tile/toggle_pin"};
+    wf::option_wrapper_t<wf::activatorbinding_t> opt_toggle_hud{"animated-tile/toggle_hud"};
+    wf::option_wrapper_t<wf::activatorbinding_t> opt_equalize{"animated-tile/equalize"};
+    wf::option_wrapper_t<wf::activatorbinding_t> opt_rotate{"animated-tile/rotate"};
+    wf::option_wrapper_t<wf::activatorbinding_t> opt_mirror_horizontal{"animated-tile/mirror_horizontal"};
+    wf::option_wrapper_t<wf::activatorbinding_t> opt_mirror_vertical{"animated-tile/mirror_vertical"};
+    wf::option_wrapper_t<wf::activatorbinding_t> opt_toggle_split{"animated-tile/toggle_split"};
+    wf::option_wrapper_t<wf::activatorbinding_t> opt_swap_next{"animated-tile/swap_next"};
+    wf::option_wrapper_t<wf::activatorbinding_t> opt_swap_prev{"animated-tile/swap_prev"};
+    wf::option_wrapper_t<wf::activatorbinding_t> opt_flatten{"animated-tile/flatten"};
+    wf::option_wrapper_t<wf::activatorbinding_t> opt_binarize{"animated-tile/binarize"};
+    wf::option_wrapper_t<wf::activatorbinding_t> opt_preselect_left{"animated-tile/preselect_left"};
+    wf::option_wrapper_t<wf::activatorbinding_t> opt_preselect_right{"animated-tile/preselect_right"};
+    wf::option_wrapper_t<wf::activatorbinding_t> opt_preselect_up{"animated-tile/preselect_up"};
+    wf::option_wrapper_t<wf::activatorbinding_t> opt_preselect_down{"animated-tile/preselect_down"};
+    wf::option_wrapper_t<wf::activatorbinding_t> opt_preselect_cancel{"animated-tile/preselect_cancel"};
+    
+    // Preselection
+    wf::option_wrapper_t<double> opt_preselect_ratio{"animated-tile/preselect_ratio"};
+    wf::option_wrapper_t<wf::color_t> opt_preselect_color{"animated-tile/preselect_color"};
+    
+    // Borders
+    wf::option_wrapper_t<int> opt_border_width{"animated-tile/border_width"};
+    wf::option_wrapper_t<wf::color_t> opt_border_color_active{"animated-tile/border_color_active"};
+    wf::option_wrapper_t<wf::color_t> opt_border_color_inactive{"animated-tile/border_color_inactive"};
+    
+    // Touchpad gestures
+    wf::option_wrapper_t<int> opt_gesture_fingers{"animated-tile/gesture_fingers"};
+    wf::option_wrapper_t<int> opt_gesture_distance{"animated-tile/gesture_distance"};
+    
+    // Max windows per workspace (0 = unlimited)
+    wf::option_wrapper_t<int> opt_max_windows_per_workspace{"animated-tile/max_windows_per_workspace"};
+    
+    // Separate animation durations (like Hyprland)
+    wf::option_wrapper_t<int> opt_duration_in{"animated-tile/duration_in"};
+    wf::option_wrapper_t<int> opt_duration_out{"animated-tile/duration_out"};
+    wf::option_wrapper_t<int> opt_duration_move{"animated-tile/duration_move"};
+    
+    // Separate bezier curves for windowsIn (0 = use default)
+    wf::option_wrapper_t<double> opt_bezier_in_p1_x{"animated-tile/bezier_in_p1_x"};
+    wf::option_wrapper_t<double> opt_bezier_in_p1_y{"animated-tile/bezier_in_p1_y"};
+    wf::option_wrapper_t<double> opt_bezier_in_p2_x{"animated-tile/bezier_in_p2_x"};
+    wf::option_wrapper_t<double> opt_bezier_in_p2_y{"animated-tile/bezier_in_p2_y"};
+    
+    // Separate bezier curves for windowsOut
+    wf::option_wrapper_t<double> opt_bezier_out_p1_x{"animated-tile/bezier_out_p1_x"};
+    wf::option_wrapper_t<double> opt_bezier_out_p1_y{"animated-tile/bezier_out_p1_y"};
+    wf::option_wrapper_t<double> opt_bezier_out_p2_x{"animated-tile/bezier_out_p2_x"};
+    wf::option_wrapper_t<double> opt_bezier_out_p2_y{"animated-tile/bezier_out_p2_y"};
+    
+    // Separate bezier curves for windowsMove (resize/reposition)
+    wf::option_wrapper_t<double> opt_bezier_move_p1_x{"animated-tile/bezier_move_p1_x"};
+    wf::option_wrapper_t<double> opt_bezier_move_p1_y{"animated-tile/bezier_move_p1_y"};
+    wf::option_wrapper_t<double> opt_bezier_move_p2_x{"animated-tile/bezier_move_p2_x"};
+    wf::option_wrapper_t<double> opt_bezier_move_p2_y{"animated-tile/bezier_move_p2_y"};
+    
+    void init() override
+    {
+        // Setup bezier curves for different animation types
+        updateAnimationConfigs();
+        
+        // Get workspace bounds
+        updateWorkspaceBounds();
+        
+        // Publish goal geometry for other plugins
+        auto query = std::make_unique<layout_query_t>();
+        query->grid_width = output->wset()->get_workspace_grid_size().width;
+        output->store_data(std::move(query));
+        
+        // Connect signals
+        output->connect(&on_view_mapped);
+        output->connect(&on_view_unmapped);
+        output->connect(&on_workarea_changed);
+        output->connect(&on_output_config_changed);
+        output->connect(&on_plugin_activation_changed);
+        output->connect(&on_workspace_changed);
+        output->connect(&on_view_focused);
+        
+        // Connect move request for drag-to-swap
+        output->connect(&on_move_request);
+        
+        // Keybindings
+        output->add_activator(opt_focus_last, &on_focus_last);
+        output->add_activator(opt_toggle_monocle, &on_toggle_monocle);
+        output->add_activator(opt_next_tab, &on_next_tab);
+        output->add_activator(opt_prev_tab, &on_prev_tab);
+        output->add_activator(opt_toggle_pseudotile, &on_toggle_pseudotile);
+        output->add_activator(opt_toggle_pin, &on_toggle_pin);
+        output->add_activator(opt_toggle_hud, &on_toggle_hud);
+        output->add_activator(opt_equalize, &on_equalize);
+        output->add_activator(opt_rotate, &on_rotate);
+        output->add_activator(opt_mirror_horizontal, &on_mirror_horizontal);
+        output->add_activator(opt_mirror_vertical, &on_mirror_vertical);
+        output->add_activator(opt_toggle_split, &on_toggle_split);
+        output->add_activator(opt_swap_next, &on_swap_next);
+        output->add_activator(opt_swap_prev, &on_swap_prev);
+        output->add_activator(opt_flatten, &on_flatten);
+        output->add_activator(opt_binarize, &on_binarize);
+        output->add_activator(opt_preselect_left, &on_preselect_left);
+        output->add_activator(opt_preselect_right, &on_preselect_right);
+        output->add_activator(opt_preselect_up, &on_preselect_up);
+        output->add_activator(opt_preselect_down, &on_preselect_down);
+        output->add_activator(opt_preselect_cancel, &on_preselect_cancel);
+        
+        // Connect to core for pointer events during drag
+        wf::get_core().connect(&on_pointer_motion);
+        wf::get_core().connect(&on_pointer_button);
+        
+        // Touchpad swipes scrub layout transitions
+        wf::get_core().connect(&on_swipe_begin);
+        wf::get_core().connect(&on_swipe_update);
+        wf::get_core().connect(&on_swipe_end);
+        
+        wf::get_core().connect(&on_view_moved_to_wset);
+        
+        // Track presentation feedback to predict when frames hit the screen
+        m_onPresent.set_callback([this] (void *data)
+        {
+            auto ev = static_cast<wlr_output_event_present*>(data);
+            if (!ev->presented || !ev->when)
+                return;
+            
+            m_lastPresentTime = AnimClock::time_point(
+                std::chrono::duration_cast<AnimClock::duration>(
+                    std::chrono::seconds(ev->when->tv_sec) +
+                    std::chrono::nanoseconds(ev->when->tv_nsec)));
+            if (ev->refresh > 0)
+                m_refreshPeriod = std::chrono::nanoseconds(ev->refresh);
+        });
+        m_onPresent.connect(&output->handle->events.present);
+        
+        // Start animation tick loop
+        m_animationActive = false;
+        
+        joinSpan();
+        openTelemetry();
+        
+        // This output was here before: take its windows back in their
+        // old layout
+        adoptParkedTrees();
+    }
+    
+    void fini() override
+    {
+        // End any active grab
+        end_grab();
+        
+        output->rem_binding(&on_focus_last);
+        output->rem_binding(&on_toggle_monocle);
+        output->rem_binding(&on_next_tab);
+        output->rem_binding(&on_prev_tab);
+        output->rem_binding(&on_toggle_pseudotile);
+        output->rem_binding(&on_toggle_pin);
+        output->rem_binding(&on_toggle_hud);
+        output->rem_binding(&on_equalize);
+        output->rem_binding(&on_rotate);
+        output->rem_binding(&on_mirror_horizontal);
+        output->rem_binding(&on_mirror_vertical);
+        output->rem_binding(&on_toggle_split);
+        output->rem_binding(&on_swap_next);
+        output->rem_binding(&on_swap_prev);
+        output->rem_binding(&on_flatten);
+        output->rem_binding(&on_binarize);
+        output->rem_binding(&on_preselect_left);
+        output->rem_binding(&on_preselect_right);
+        output->rem_binding(&on_preselect_up);
+        output->rem_binding(&on_preselect_down);
+        output->rem_binding(&on_preselect_cancel);
+        
+        // Remove overlays
+        if (m_preselectOverlay)
+        {
+            wf::scene::remove_child(m_preselectOverlay);
+            m_preselectOverlay = nullptr;
+        }
+        
+        if (m_borderNode)
+        {
+            wf::scene::remove_child(m_borderNode);
+            m_borderNode = nullptr;
+        }
+        
+        setHudVisible(false);
+        
+        // Pinned windows go back to being ordinary windows until the
+        // output (or the next plugin instance) takes them back
+        parkPinnedViews();
+        
+        // The other outputs of a span keep tiling (and own the views of)
+        // the shared trees; only the last member tears them down
+        bool spanContinues = m_span && m_span->members.size() > 1;
+        leaveSpan();
+        
+        if (spanContinues)
+        {
+            m_trees.clear();
+        }
+        else
+        {
+            // Remove all transformers from all trees
+            for (auto& [wsIndex, tree] : m_trees)
+            {
+                for (auto& view : tree->getViews())
+                {
+                    // Bring back terminals hidden by swallowing; the parked
+                    // tree remembers the pair for when it is adopted again
+                    if (view->has_data<ViewAnimData>())
+                    {
+                        auto terminal = view->get_data<ViewAnimData>()->swallowedView;
+                        if (terminal)
+                        {
+                            wf::scene::set_node_enabled(terminal->get_root_node(), true);
+                            removeTransformer(terminal);
+                            terminal->erase_data<ViewAnimData>();
+                            tree->parkSwallow(view, terminal);
+                        }
+                    }
+                    
+                    // Show tiles hidden by monocle or tabbing again
+                    if (view->has_data<ViewAnimData>() &&
+                        view->get_data<ViewAnimData>()->hiddenByLayout)
+                    {
+                        wf::scene::set_node_enabled(view->get_root_node(), true);
+                        view->get_data<ViewAnimData>()->hiddenByLayout = false;
+                    }
+                    
+                    removeTransformer(view);
+                    view->erase_data<ViewAnimData>();
+                }
+            }
+            
+            parkTrees();
+        }
+        
+        // Stop animation loop
+        if (m_animationActive)
+        {
+            output->render->rem_effect(&m_animationHook);
+        }
+        
+        // The published layouts point into the trees
+        output->erase_data<layout_query_t>();
+        
+        // Disconnect core signals
+        on_pointer_motion.disconnect();
+        on_pointer_button.disconnect();
+        on_swipe_begin.disconnect();
+        on_swipe_update.disconnect();
+        on_swipe_end.disconnect();
+        on_view_moved_to_wset.disconnect();
+        releaseGesture();
+        m_onPresent.disconnect();
+        m_clearInstantRemap.disconnect();
+        m_dumpOnIdle.disconnect();
+        closeTelemetry();
+    }
+    
+  private:
+    // Animation configs per type
+    AnimationConfig m_animConfigIn;
+    AnimationConfig m_animConfigOut;
+    AnimationConfig m_animConfigMove;
+    
+    BezierCurve m_bezier;  // Default/shared bezier
+    
+    // Map of workspace coordinates to tile trees
+    // Key is treeKey(workspace index (y * grid_width + x), zone)
+    std::map<int, std::shared_ptr<TileTree>> m_trees;
+    
+    // Relative widths of the zones every workspace is divided into, and
+    // the zone that last had focus per workspace
+    std::vector<float> m_zoneWeights{1.0f};
+    std::map<int, int> m_activeZones;
+    
+    // Last layout generation announced with layout_changed_signal, per tree
+    std::map<int, uint64_t> m_announcedGenerations;
+    
+    wf::geometry_t m_workspaceBounds;
+    bool m_animationActive = false;
+    wf::point_t m_cursorPos{0, 0};
+    
+    // Drag-to-swap state
+    DragState m_dragState;
+    
+    // Gesture-driven transition state
+    GestureState m_gesture;
+    
+    // Presentation feedback, used to sample animations at display time
+    wf::wl_listener_wrapper m_onPresent;
+    std::optional<AnimClock::time_point> m_lastPresentTime;
+    std::chrono::nanoseconds m_refreshPeriod{0};
+    
+    wf::effect_hook_t m_animationHook = [this] ()
+    {
+        auto start = AnimClock::now();
+        tickAnimations();
+        auto tickUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            AnimClock::now() - start).count();
+        
+        int64_t intervalUs = m_lastFrameStart ? std::chrono::duration_cast<
+            std::chrono::microseconds>(start - *m_lastFrameStart).count() : 0;
+        m_lastFrameStart = m_animationActive ? std::optional(start) : std::nullopt;
+        
+        m_recorder.record(TraceEvent::FRAME, static_cast<int32_t>(tickUs),
+            static_cast<int32_t>(std::min<int64_t>(intervalUs, INT32_MAX)));
+        checkForJank(intervalUs);
+        
+        if (m_tickSampleCount < m_tickSamples.size())
+            m_tickSamples[m_tickSampleCount++] = static_cast<uint32_t>(tickUs);
+        m_hudTicks[m_hudNextTick++ % m_hudTicks.size()] = static_cast<uint32_t>(tickUs);
+        m_hudDirty = true;
+    };
+    
+    // ============================================================================
+    // Flight recorder
+    // ============================================================================
+    
+    FlightRecorder m_recorder;
+    std::optional<AnimClock::time_point> m_lastFrameStart;
+    std::optional<AnimClock::time_point> m_lastJankDump;
+    static constexpr uint64_t TRACE_FILES = 8;
+    uint64_t m_traceDumps = 0;
+    wf::wl_idle_call m_dumpOnIdle;
+    
+    // A frame interval over the threshold dumps the recorder once the
+    // frame is done (at most every 10 s, so a bad patch is one file)
+    void checkForJank(int64_t intervalUs)
+    {
+        int thresholdMs = opt_jank_threshold;
+        if (thresholdMs <= 0 || intervalUs <= int64_t(thresholdMs) * 1000)
+            return;
+        
+        auto now = AnimClock::now();
+        if (m_lastJankDump && now - *m_lastJankDump < std::chrono::seconds(10))
+            return;
+        
+        m_lastJankDump = now;
+        auto reason = "frame interval " + std::to_string(intervalUs / 1000) + " ms";
+        m_dumpOnIdle.run_once([this, reason] { dumpTrace(reason); });
+    }
+    
+    // ============================================================================
+    // Telemetry - live counters in a shared-memory file that external tools
+    // sample without IPC (layout in animated-tile/telemetry.hpp)
+    // ============================================================================
+    
+    telemetry_t *m_telemetry = nullptr;
+    std::string m_telemetryPath;
+    wf::wl_timer<true> m_secondTimer;  // Runs while telemetry or the HUD is on
+    
+    // Accumulated over the current second
+    uint32_t m_configureCount = 0;
+    std::array<uint32_t, 2048> m_tickSamples{};
+    size_t m_tickSampleCount = 0;
+    
+    // Results of the last full second
+    uint32_t m_configuresPerSecond = 0;
+    std::array<uint32_t, 4> m_tickPercentiles{};  // p50, p90, p99, max
+    
+    void openTelemetry()
+    {
+        m_telemetryPath = runtimePath("animated-tile-" + output->to_string() + ".telemetry");
+        if (!opt_telemetry || m_telemetryPath.empty())
+            return;
+        
+        // A fresh inode: truncating a file that a reader still has mapped
+        // would fault that reader
+        unlink(m_telemetryPath.c_str());
+        int fd = open(m_telemetryPath.c_str(),
+            O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0644);
+        if (fd < 0)
+            return;
+        
+        if (ftruncate(fd, sizeof(telemetry_t)) == 0)
+        {
+            void *mem = mmap(nullptr, sizeof(telemetry_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (mem != MAP_FAILED)
+            {
+                m_telemetry = new (mem) telemetry_t();
+                m_telemetry->magic = TELEMETRY_MAGIC;
+                m_telemetry->version = TELEMETRY_VERSION;
+            }
+        }
+        close(fd);
+        
+        if (!m_telemetry)
+        {
+            unlink(m_telemetryPath.c_str());
+            return;
+        }
+        
+        publishTelemetry();
+        updateSecondTimer();
+    }
+    
+    void closeTelemetry()
+    {
+        if (m_telemetry)
+        {
+            munmap(m_telemetry, sizeof(telemetry_t));
+            unlink(m_telemetryPath.c_str());
+            m_telemetry = nullptr;
+        }
+        updateSecondTimer();
+    }
+    
+    // Arm the once-per-second roll while anything shows its results
+    void updateSecondTimer()
+    {
+        bool wanted = m_telemetry || m_hudNode;
+        if (!wanted)
+        {
+            m_secondTimer.disconnect();
+        }
+        else if (!m_secondTimer.is_connected())
+        {
+            // Nothing rolled the counters while the timer was off
+            m_configureCount = 0;
+            m_configuresPerSecond = 0;
+            m_tickSampleCount = 0;
+            m_secondTimer.set_timeout(1000, [this] ()
+            {
+                rollSecond();
+                return true;
+            });
+        }
+    }
+    
+    // Per-second rates and the tick time percentiles of the last second
+    void rollSecond()
+    {
+        m_configuresPerSecond = m_configureCount;
+        m_configureCount = 0;
+        
+        auto begin = m_tickSamples.begin();
+        auto end = begin + m_tickSampleCount;
+        auto percentile = [&] (double p) -> uint32_t
+        {
+            if (begin == end)
+                return 0;
+            auto nth = begin + static_cast<size_t>(p * (m_tickSampleCount - 1));
+            std::nth_element(begin, nth, end);
+            return *nth;
+        };
+        
+        m_tickPercentiles = {percentile(0.5), percentile(0.9), percentile(0.99), percentile(1.0)};
+        m_tickSampleCount = 0;
+        publishTelemetry();
+        
+        // An idle output renders no frames; redraw so the HUD shows the roll
+        if (m_hudNode)
+        {
+            m_hudChannels = 0;
+            for (auto& [key, tree] : m_trees)
+                m_hudChannels += tree->countAnimatingChannels();
+            m_hudDirty = true;
+            output->render->schedule_redraw();
+        }
+    }
+    
+    // Seqlock write: odd sequence, payload, even sequence. Walks every tree,
+    // so it runs from the one-second timer and never from the frame hook
+    void publishTelemetry()
+    {
+        if (!m_telemetry)
+            return;
+        
+        uint32_t seq = m_telemetry->sequence.load(std::memory_order_relaxed);
+        m_telemetry->sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        
+        auto& d = m_telemetry->data;
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        d.update_time_ns = uint64_t(now.tv_sec) * 1'000'000'000ULL + now.tv_nsec;
+        
+        d.active_animations = 0;
+        for (auto& [key, tree] : m_trees)
+            d.active_animations += tree->countAnimating();
+        
+        d.configures_per_second = m_configuresPerSecond;
+        d.tick_us_p50 = m_tickPercentiles[0];
+        d.tick_us_p90 = m_tickPercentiles[1];
+        d.tick_us_p99 = m_tickPercentiles[2];
+        d.tick_us_max = m_tickPercentiles[3];
+        
+        int count = std::min(getTotalWorkspaces(), TELEMETRY_MAX_WORKSPACES);
+        d.workspace_count = count;
+        for (int i = 0; i < count; i++)
+            d.tree_sizes[i] = workspaceWindowCount(i);
+        
+        m_telemetry->sequence.store(seq + 2, std::memory_order_release);
+    }
+    
+  public:
+    // Write this output's recorder to a file; returns its path, or an empty
+    // string on failure. Dumps rotate through TRACE_FILES files per output,
+    // so sustained jank cannot fill the runtime directory
+    std::string dumpTrace(const std::string& reason)
+    {
+        auto path = runtimePath("animated-tile-" + output->to_string() + "-" +
+            std::to_string(m_traceDumps++ % TRACE_FILES) + ".trace");
+        
+        char when[32] = "";
+        std::time_t now = std::time(nullptr);
+        std::strftime(when, sizeof(when), "%F %T", std::localtime(&now));
+        auto header = output->to_string() + ", " + when + ", " + reason;
+        return m_recorder.dump(path, header) ? path : "";
+    }
+    
+  private:
+    
+    // Predict when the frame currently being built will be presented:
+    // the first vblank after now, extrapolated from the last presentation.
+    // Falls back to the current time without presentation feedback.
+    AnimClock::time_point predictPresentationTime() const
+    {
+        auto now = AnimClock::now();
+        
+        auto period = m_refreshPeriod;
+        if (period.count() <= 0 && output->handle->refresh > 0)
+        {
+            // wlr_output::refresh is in mHz
+            period = std::chrono::nanoseconds(
+                1'000'000'000'000LL / output->handle->refresh);
+        }
+        
+        if (!m_lastPresentTime || period.count() <= 0)
+            return now;
+        
+        auto sinceLast = now - *m_lastPresentTime;
+        if (sinceLast < AnimClock::duration::zero())
+            return *m_lastPresentTime;
+        
+        auto frames = sinceLast / period + 1;
+        return *m_lastPresentTime + std::chrono::duration_cast<AnimClock::duration>(
+            period * frames);
+    }
+    
+    // Get workspace index from coordinates
+    int workspaceIndex(wf::point_t ws)
+    {
+        auto grid = output->wset()->get_workspace_grid_size();
+        return ws.y * grid.width + ws.x;
+    }
+    
+    // Get workspace coordinates from index
+    wf::point_t workspaceCoords(int index)
+    {
+        auto grid = output->wset()->get_workspace_grid_size();
+        return {index % grid.width, index / grid.width};
+    }
+    
+    // Get total number of workspaces
+    int getTotalWorkspaces()
+    {
+        auto grid = output->wset()->get_workspace_grid_size();
+        return grid.width * grid.height;
+    }
+    
+    // Get workspace index for a view
+    int getViewWorkspaceIndex(wayfire_toplevel_view view)
+    {
+        auto ws = output->wset()->get_view_main_workspace(view);
+        return workspaceIndex(ws);
+    }
+    
+    // Get current workspace index
+    int getCurrentWorkspaceIndex()
+    {
+        auto ws = output->wset()->get_current_workspace();
+        return workspaceIndex(ws);
+    }
+    
+    // ============================================================================
+    // Zones - a workspace can be split into side-by-side zones, each tiled by
+    // its own tree inside its own bounds
+    // ============================================================================
+    
+    static constexpr int MAX_ZONES = 16;
+    
+    static int treeKey(int wsIndex, int zone) { return wsIndex * MAX_ZONES + zone; }
+    static int keyWorkspace(int key) { return key / MAX_ZONES; }
+    static int keyZone(int key) { return key % MAX_ZONES; }
+    
+    int zoneCount() const { return static_cast<int>(m_zoneWeights.size()); }
+    
+    // Slice of the workarea belonging to a zone
+    wf::geometry_t zoneBounds(int zone)
+    {
+        zone = std::clamp(zone, 0, zoneCount() - 1);
+        float total = std::accumulate(m_zoneWeights.begin(), m_zoneWeights.end(), 0.0f);
+        float before = std::accumulate(m_zoneWeights.begin(), m_zoneWeights.begin() + zone, 0.0f);
+        
+        auto bounds = tilingArea();
+        int left = bounds.x + static_cast<int>(std::lround(bounds.width * before / total));
+        int right = bounds.x + static_cast<int>(
+            std::lround(bounds.width * (before + m_zoneWeights[zone]) / total));
+        bounds.x = left;
+        bounds.width = right - left;
+        return bounds;
+    }
+    
+    // Zone containing an output-local x coordinate
+    int zoneAt(int x)
+    {
+        for (int zone = 0; zone < zoneCount() - 1; zone++)
+        {
+            auto bounds = zoneBounds(zone);
+            if (x < bounds.x + bounds.width)
+                return zone;
+        }
+        return zoneCount() - 1;
+    }
+    
+    int activeZone(int wsIndex)
+    {
+        auto it = m_activeZones.find(wsIndex);
+        int zone = (it != m_activeZones.end()) ? it->second : 0;
+        return std::min(zone, zoneCount() - 1);
+    }
+    
+    // New windows go to the zone under the cursor, or to the focused zone
+    // when the cursor is elsewhere
+    int insertionZone(int wsIndex)
+    {
+        if (zoneCount() == 1)
+            return 0;
+        
+        auto cursor = wf::get_core().get_cursor_position();
+        auto og = output->get_layout_geometry();
+        bool onOutput = cursor.x >= og.x && cursor.x < og.x + og.width &&
+            cursor.y >= og.y && cursor.y < og.y + og.height;
+        if (onOutput && wsIndex == getCurrentWorkspaceIndex())
+            return zoneAt(static_cast<int>(cursor.x) - og.x);
+        
+        return activeZone(wsIndex);
+    }
+    
+    // Every existing zone tree of a workspace, left to right
+    std::vector<TileTree*> workspaceTrees(int wsIndex)
+    {
+        std::vector<TileTree*> trees;
+        auto end = m_trees.lower_bound(treeKey(wsIndex + 1, 0));
+        for (auto it = m_trees.lower_bound(treeKey(wsIndex, 0)); it != end; ++it)
+            trees.push_back(it->second.get());
+        return trees;
+    }
+    
+    int workspaceWindowCount(int wsIndex)
+    {
+        int count = 0;
+        for (auto tree : workspaceTrees(wsIndex))
+            count += tree->getWindowCount();
+        return count;
+    }
+    
+    // The focused zone's tree on the current workspace, if it exists
+    TileTree* findActiveTree()
+    {
+        int wsIndex = getCurrentWorkspaceIndex();
+        auto it = m_trees.find(treeKey(wsIndex, activeZone(wsIndex)));
+        return (it != m_trees.end()) ? it->second.get() : nullptr;
+    }
+    
+    TileTree* activeTree()
+    {
+        int wsIndex = getCurrentWorkspaceIndex();
+        return getTreeForWorkspace(wsIndex, activeZone(wsIndex));
+    }
+    
+    TileTree* findTreeOfView(ViewAnimData *data)
+    {
+        auto it = m_trees.find(treeKey(data->workspaceIndex, data->zone));
+        return (it != m_trees.end()) ? it->second.get() : nullptr;
+    }
+    
+    // Publish the zone layouts of a workspace, in zone order
+    void publishWorkspaceLayouts(int wsIndex)
+    {
+        auto query = output->get_data<layout_query_t>();
+        if (!query)
+            return;
+        
+        auto& zones = query->workspaces[wsIndex];
+        zones.clear();
+        for (auto tree : workspaceTrees(wsIndex))
+            zones.push_back(&tree->publishedLayout());
+    }
+    
+    // ============================================================================
+    // Spanning - this output as one member of a SpanGroup
+    // ============================================================================
+    
+    SpanGroup *m_span = nullptr;
+    
+    void joinSpan()
+    {
+        auto names = splitList(opt_span_outputs);
+        if (std::find(names.begin(), names.end(), output->to_string()) == names.end())
+            return;
+        
+        m_span = wf::get_core().get_data_safe<SpanGroup>();
+        m_span->bezel = std::max(0, int(opt_span_bezel));
+        
+        SpanGroup::Member member;
+        member.output = output;
+        member.kick = [this] { startLocalAnimationLoop(); };
+        member.resize = [this] { updateWorkspaceBounds(); };
+        member.relayout = [this]
+        {
+            // Shared trees may still point at the curve of a member that
+            // just left; the relayouting member re-points them to its own
+            updateTreeConfig();
+            for (auto& [key, tree] : m_trees)
+                tree->recalculateLayout(true);
+            migrateSpanViews();
+        };
+        member.share = [this] (int key)
+        {
+            auto& tree = m_span->trees[key];
+            tree->setBounds(treeBounds(key));
+            m_trees[key] = tree;
+            publishWorkspaceLayouts(keyWorkspace(key));
+        };
+        m_span->join(std::move(member));
+    }
+    
+    void leaveSpan()
+    {
+        if (!m_span)
+            return;
+        
+        auto span = m_span;
+        m_span = nullptr;
+        span->leave(output);
+    }
+    
+    // Bounds a tree is laid out in: the whole span, or the tree's zone
+    wf::geometry_t treeBounds(int key)
+    {
+        return m_span ? m_span->bounds() : zoneBounds(keyZone(key));
+    }
+    
+    // Offset from tree coordinates to this output's local coordinates
+    wf::point_t spanOffset()
+    {
+        if (!m_span)
+            return {0, 0};
+        
+        auto rect = m_span->rectOf(output);
+        auto workarea = output->workarea->get_workarea();
+        return {workarea.x - rect.x, workarea.y - rect.y};
+    }
+    
+    std::optional<wf::geometry_t> localGoal(TileTree* tree, wayfire_toplevel_view view)
+    {
+        auto goal = tree->getViewGoalGeometry(view);
+        if (goal)
+        {
+            auto offset = spanOffset();
+            goal->x += offset.x;
+            goal->y += offset.y;
+        }
+        return goal;
+    }
+    
+    // Global cursor position in tree coordinates
+    wf::point_t cursorInTree(wf::point_t cursor)
+    {
+        auto origin = output->get_layout_geometry();
+        auto offset = spanOffset();
+        return {cursor.x - origin.x - offset.x, cursor.y - origin.y - offset.y};
+    }
+    
+    // The visible views of a tree this output configures, damages and
+    // borders: all of them, or when spanning only those whose tile lies on
+    // this output and that migrateSpanViews() already moved here
+    std::vector<wayfire_toplevel_view> viewsShownHere(TileTree* tree)
+    {
+        auto views = tree->getVisibleViews();
+        if (!m_span)
+            return views;
+        
+        std::vector<wayfire_toplevel_view> shown;
+        for (auto& view : views)
+        {
+            auto goal = tree->getViewGoalGeometry(view);
+            if (goal && m_span->ownerOf(*goal) == output && view->get_output() == output)
+                shown.push_back(view);
+        }
+        return shown;
+    }
+    
+    // Move every view of the current workspace to the member its tile is
+    // on. Runs after layout passes and workspace switches, never from a
+    // frame hook, so no member sees views change outputs mid-frame
+    void migrateSpanViews()
+    {
+        if (!m_span)
+            return;
+        
+        for (auto tree : workspaceTrees(getCurrentWorkspaceIndex()))
+        {
+            for (auto& view : tree->getVisibleViews())
+            {
+                auto goal = tree->getViewGoalGeometry(view);
+                auto owner = goal ? m_span->ownerOf(*goal) : nullptr;
+                if (!owner || view->get_output() == owner)
+                    continue;
+                
+                wf::move_view_to_output(view, owner, false);
+                owner->wset()->move_to_workspace(view, owner->wset()->get_current_workspace());
+                view->get_data_safe<ViewAnimData>()->lastScale = -1.0f;
+            }
+        }
+    }
+    
+    // Take a tree into this output's set, or into every member's when
+    // spanning
+    TileTree* addTree(int key, std::shared_ptr<TileTree> tree)
+    {
+        if (m_span)
+        {
+            m_span->addTree(key, std::move(tree));
+            return m_trees[key].get();
+        }
+        
+        tree->setBounds(treeBounds(key));
+        m_trees[key] = tree;
+        publishWorkspaceLayouts(keyWorkspace(key));
+        return tree.get();
+    }
+    
+    // Find the next workspace with available space
+    // Returns -1 if all workspaces are full
+    int findNextAvailableWorkspace(int startFromIndex)
+    {
+        int maxWindows = opt_max_windows_per_workspace;
+        if (maxWindows <= 0)
+        {
+            // Unlimited - just use the starting workspace
+            return startFromIndex;
+        }
+        
+        int totalWorkspaces = getTotalWorkspaces();
+        
+        // First, check the starting workspace
+        if (workspaceWindowCount(startFromIndex) < maxWindows)
+        {
+            return startFromIndex;
+        }
+        
+        // Search through all workspaces starting from the next one
+        for (int i = 1; i < totalWorkspaces; i++)
+        {
+            int wsIndex = (startFromIndex + i) % totalWorkspaces;
+            
+            if (workspaceWindowCount(wsIndex) < maxWindows)
+            {
+                return wsIndex;
+            }
+        }
+        
+        // All workspaces are full - return -1 to indicate overflow
+        // Or we could fall back to current workspace (user's choice)
+        return -1;
+    }
+    
+    // Get or create tree for a zone of a workspace
+    TileTree* getTreeForWorkspace(int wsIndex, int zone = 0)
+    {
+        auto it = m_trees.find(treeKey(wsIndex, zone));
+        if (it == m_trees.end())
+        {
+            auto tree = std::make_shared<TileTree>();
+            tree->setConfig(
+                &m_bezier,
+                static_cast<float>(int(opt_duration)),
+                opt_gaps_in,
+                opt_gaps_out,
+                opt_preserve_split,
+                static_cast<float>(double(opt_split_width_multiplier)),
+                opt_force_split,
+                opt_smart_split,
+                opt_nary_containers,
+                opt_min_tile_width,
+                opt_min_tile_height
+            );
+            tree->setLayoutPolicy(parseLayoutPolicy(opt_auto_layout));
+            tree->setPseudotileAlign(parseAlignment(opt_pseudotile_align));
+            return addTree(treeKey(wsIndex, zone), std::move(tree));
+        }
+        return it->second.get();
+    }
+    
+    // Get tree for a view (based on view's workspace)
+    TileTree* getTreeForView(wayfire_toplevel_view view)
+    {
+        int wsIndex = getViewWorkspaceIndex(view);
+        int zone = view->has_data<ViewAnimData>() ? view->get_data<ViewAnimData>()->zone : 0;
+        return getTreeForWorkspace(wsIndex, zone);
+    }
+    
+    void updateAnimationConfigs()
+    {
+        // Default bezier curve values
+        float p1x = static_cast<float>(double(opt_bezier_p1_x));
+        float p1y = static_cast<float>(double(opt_bezier_p1_y));
+        float p2x = static_cast<float>(double(opt_bezier_p2_x));
+        float p2y = static_cast<float>(double(opt_bezier_p2_y));
+        
+        m_bezier = BezierCurve(p1x, p1y, p2x, p2y);
+        
+        // Configure each animation type
+        // Use specific durations if set, otherwise fall back to main duration
+        int durationIn = opt_duration_in > 0 ? int(opt_duration_in) : int(opt_duration);
+        int durationOut = opt_duration_out > 0 ? int(opt_duration_out) : int(opt_duration);
+        int durationMove = opt_duration_move > 0 ? int(opt_duration_move) : int(opt_duration);
+        
+        // Helper to check if a bezier is set (non-zero values)
+        auto hasCustomBezier = [](double p1x, double p1y, double p2x, double p2y) {
+            // Consider it custom if any value is non-zero (default is 0)
+            return (p1x != 0.0 || p1y != 0.0 || p2x != 0.0 || p2y != 0.0);
+        };
+        
+        // WindowsIn bezier - use custom if set, otherwise default
+        if (hasCustomBezier(opt_bezier_in_p1_x, opt_bezier_in_p1_y, 
+                           opt_bezier_in_p2_x, opt_bezier_in_p2_y))
+        {
+            m_animConfigIn.setCurve(
+                static_cast<float>(double(opt_bezier_in_p1_x)),
+                static_cast<float>(double(opt_bezier_in_p1_y)),
+                static_cast<float>(double(opt_bezier_in_p2_x)),
+                static_cast<float>(double(opt_bezier_in_p2_y))
+            );
+        }
+        else
+        {
+            m_animConfigIn.setCurve(p1x, p1y, p2x, p2y);
+        }
+        m_animConfigIn.durationMs = static_cast<float>(durationIn);
+        m_animConfigIn.popinPercent = static_cast<float>(double(opt_popin_percent));
+        
+        // WindowsOut bezier
+        if (hasCustomBezier(opt_bezier_out_p1_x, opt_bezier_out_p1_y,
+                           opt_bezier_out_p2_x, opt_bezier_out_p2_y))
+        {
+            m_animConfigOut.setCurve(
+                static_cast<float>(double(opt_bezier_out_p1_x)),
+                static_cast<float>(double(opt_bezier_out_p1_y)),
+                static_cast<float>(double(opt_bezier_out_p2_x)),
+                static_cast<float>(double(opt_bezier_out_p2_y))
+            );
+        }
+        else
+        {
+            m_animConfigOut.setCurve(p1x, p1y, p2x, p2y);
+        }
+        m_animConfigOut.durationMs = static_cast<float>(durationOut);
+        
+        // WindowsMove bezier (resize/reposition when layout changes)
+        if (hasCustomBezier(opt_bezier_move_p1_x, opt_bezier_move_p1_y,
+                           opt_bezier_move_p2_x, opt_bezier_move_p2_y))
+        {
+            m_animConfigMove.setCurve(
+                static_cast<float>(double(opt_bezier_move_p1_x)),
+                static_cast<float>(double(opt_bezier_move_p1_y)),
+                static_cast<float>(double(opt_bezier_move_p2_x)),
+                static_cast<float>(double(opt_bezier_move_p2_y))
+            );
+        }
+        else
+        {
+            m_animConfigMove.setCurve(p1x, p1y, p2x, p2y);
+        }
+        m_animConfigMove.durationMs = static_cast<float>(durationMove);
+    }
+    
+    void updateTreeConfig()
+    {
+        // Update config for all existing trees
+        for (auto& [wsIndex, tree] : m_trees)
+        {
+            tree->setConfig(
+                &m_bezier,
+                static_cast<float>(int(opt_duration)),
+                opt_gaps_in,
+                opt_gaps_out,
+                opt_preserve_split,
+                static_cast<float>(double(opt_split_width_multiplier)),
+                opt_force_split,
+                opt_smart_split,
+                opt_nary_containers,
+                opt_min_tile_width,
+                opt_min_tile_height
+            );
+            tree->setLayoutPolicy(parseLayoutPolicy(opt_auto_layout));
+            tree->setPseudotileAlign(parseAlignment(opt_pseudotile_align));
+        }
+    }
+    
+    void updateWorkspaceBounds()
+    {
+        m_workspaceBounds = output->workarea->get_workarea();
+        // A span is one surface; zones would cut it at arbitrary places
+        m_zoneWeights = m_span ? std::vector<float>{1.0f} : parseZones(opt_zones, MAX_ZONES);
+        if (!m_span)
+            rehomeOrphanedZones();
+        
+        // Update bounds for all trees
+        for (auto& [key, tree] : m_trees)
+        {
+            tree->setBounds(treeBounds(key));
+        }
+        
+        placePinnedViews();
+    }
+    
+    // Trees of zones that no longer exist (the zones option shrank) merge
+    // into the last remaining zone of their workspace
+    void rehomeOrphanedZones()
+    {
+        std::vector<int> orphans;
+        for (auto& [key, tree] : m_trees)
+        {
+            if (keyZone(key) >= zoneCount())
+                orphans.push_back(key);
+        }
+        
+        int target = zoneCount() - 1;
+        for (int key : orphans)
+        {
+            auto orphan = std::move(m_trees[key]);
+            m_trees.erase(key);
+            m_announcedGenerations.erase(key);
+            
+            int wsIndex = keyWorkspace(key);
+            auto tree = getTreeForWorkspace(wsIndex, target);
+            for (auto& view : orphan->getViews())
+            {
+                tree->addView(view, true);
+                if (view->has_data<ViewAnimData>())
+                    view->get_data<ViewAnimData>()->zone = target;
+            }
+            
+            syncHiddenTiles(tree);
+            publishWorkspaceLayouts(wsIndex);
+        }
+        
+        if (!orphans.empty())
+            startAnimationLoop();
+    }
+    
+    // Signal handlers
+    wf::signal::connection_t<wf::view_mapped_signal> on_view_mapped =
+        [this] (wf::view_mapped_signal *ev)
+    {
+        auto view = wf::toplevel_cast(ev->view);
+        if (!view)
+            return;
+        
+        m_recorder.record(TraceEvent::VIEW_MAPPED);
+        
+        if (!opt_tile_by_default)
+            return;
+        
+        // A GUI app launched from a tiled terminal takes over its tile
+        if (opt_swallow && trySwallow(view))
+            return;
+        
+        // Update cursor position for smart_split
+        updateCursorPosition();
+        
+        // Start from the current workspace
+        int currentWsIndex = getCurrentWorkspaceIndex();
+        
+        // Find an available workspace (respecting max_windows_per_workspace)
+        int targetWsIndex = findNextAvailableWorkspace(currentWsIndex);
+        
+        if (targetWsIndex < 0)
+        {
+            // All workspaces are full - fall back to current workspace anyway
+            // (The user has more windows than workspace capacity allows)
+            targetWsIndex = currentWsIndex;
+        }
+        
+        // Get the tree for the target workspace and zone
+        int zone = insertionZone(targetWsIndex);
+        auto tree = getTreeForWorkspace(targetWsIndex, zone);
+        m_activeZones[targetWsIndex] = zone;
+        
+        // Track the newly mapped view as focused (it typically gets focus)
+        tree->setFocusedView(view);
+        
+        // If we're placing on a different workspace, move the view there 
+        // and switch to that workspace so the user sees the new window
+        if (targetWsIndex != currentWsIndex)
+        {
+            auto targetCoords = workspaceCoords(targetWsIndex);
+            
+            // First, switch the user's view to the target workspace
+            output->wset()->request_workspace(targetCoords);
+            
+            // The view will be on the current workspace initially, 
+            // but since we're switching workspaces, we need to move it
+            output->wset()->move_to_workspace(view, targetCoords);
+        }
+        
+        tileView(view, targetWsIndex, zone);
+    };
+    
+    wf::signal::connection_t<wf::view_unmapped_signal> on_view_unmapped =
+        [this] (wf::view_unmapped_signal *ev)
+    {
+        auto view = wf::toplevel_cast(ev->view);
+        if (!view)
+            return;
+        
+        m_recorder.record(TraceEvent::VIEW_UNMAPPED);
+        
+        // Cancel any drag operation involving this view
+        if (m_dragState.isDragging && m_dragState.draggedView == view)
+        {
+            m_dragState.reset();
+        }
+        
+        // Release the scrubbed transition; the relayout below retargets
+        // whatever it touches, the rest finishes on the clock
+        if (m_gesture.tracking)
+        {
+            finishGestureTransition(true);
+        }
+        
+        // A pinned window gives its space back to the trees
+        if (view->has_data<ViewAnimData>() && view->get_data<ViewAnimData>()->pinned)
+        {
+            m_pinnedViews.erase(std::remove(m_pinnedViews.begin(), m_pinnedViews.end(), view),
+                m_pinnedViews.end());
+            view->erase_data<ViewAnimData>();
+            relayoutAroundPins();
+            return;
+        }
+        
+        // A hidden, swallowed terminal is not in any tree - just detach it
+        // from the view that took its place
+        if (view->has_data<ViewAnimData>() && view->get_data<ViewAnimData>()->swallowedBy)
+        {
+            auto child = view->get_data<ViewAnimData>()->swallowedBy;
+            if (child->has_data<ViewAnimData>())
+                child->get_data<ViewAnimData>()->swallowedView = nullptr;
+            removeTransformer(view);
+            view->erase_data<ViewAnimData>();
+            return;
+        }
+        
+        // Get the workspace index from the view's stored data
+        if (view->has_data<ViewAnimData>())
+        {
+            auto data = view->get_data<ViewAnimData>();
+            if (data->isTiled && data->workspaceIndex >= 0)
+            {
+                auto tree = findTreeOfView(data);
+                if (tree && tree->hasView(view))
+                {
+                    untileView(view, tree);
+                    return;
+                }
+            }
+        }
+        
+        // Fallback: search all trees for this view
+        for (auto& [wsIndex, tree] : m_trees)
+        {
+            if (tree->hasView(view))
+            {
+                untileView(view, tree.get());
+                return;
+            }
+        }
+    };
+    
+    wf::signal::connection_t<wf::workarea_changed_signal> on_workarea_changed =
+        [this] (wf::workarea_changed_signal*)
+    {
+        auto bounds = output->workarea->get_workarea();
+        if (bounds == m_workspaceBounds)
+            return;
+        
+        m_recorder.record(TraceEvent::WORKAREA, bounds.width, bounds.height);
+        m_hudDirty = true;  // The HUD sits in the workarea's corner
+        
+        if (isSuspended())
+        {
+            m_relayoutPending = true;
+            return;
+        }
+        
+        // Part of an output mode/scale change: remap instead of animating
+        if (m_instantRemap)
+        {
+            remapAllTrees();
+            return;
+        }
+        
+        // The span's surface changed for every member
+        if (m_span)
+        {
+            m_span->resizeAll();
+            return;
+        }
+        
+        updateWorkspaceBounds();
+        // Recalculate layout for all trees
+        for (auto& [key, tree] : m_trees)
+        {
+            tree->recalculateLayout(true);
+        }
+        startAnimationLoop();
+    };
+    
+    // Resolution, scale or transform changes remap every layout in place
+    wf::signal::connection_t<wf::output_configuration_changed_signal> on_output_config_changed =
+        [this] (wf::output_configuration_changed_signal *ev)
+    {
+        m_recorder.record(TraceEvent::OUTPUT_CONFIG, static_cast<int32_t>(ev->changed_fields));
+        
+        uint32_t relevant = wf::OUTPUT_MODE_CHANGE | wf::OUTPUT_SCALE_CHANGE |
+            wf::OUTPUT_TRANSFORM_CHANGE;
+        if (!(ev->changed_fields & relevant))
+            return;
+        
+        if (isSuspended())
+        {
+            m_relayoutPending = true;
+            return;
+        }
+        
+        remapAllTrees();
+        
+        // The workarea may only follow later in this same event loop
+        // iteration; that update must not animate either
+        m_instantRemap = true;
+        m_clearInstantRemap.run_once([this] { m_instantRemap = false; });
+    };
+    
+    // ============================================================================
+    // Suspension - scale/expo/overview-style plugins own the views while they
+    // are active; no ticks, configures or damage from us until they are done
+    // ============================================================================
+    
+    std::set<std::string> m_activeExclusivePlugins;
+    bool m_relayoutPending = false;
+    
+    bool isSuspended() const { return !m_activeExclusivePlugins.empty(); }
+    
+    wf::signal::connection_t<wf::output_plugin_activated_changed_signal> on_plugin_activation_changed =
+        [this] (wf::output_plugin_activated_changed_signal *ev)
+    {
+        auto names = splitList(opt_suspend_for_plugins);
+        if (std::find(names.begin(), names.end(), ev->plugin_name) == names.end())
+            return;
+        
+        m_recorder.record(ev->activated ? TraceEvent::SUSPEND : TraceEvent::RESUME);
+        
+        if (ev->activated)
+        {
+            if (!isSuspended() && m_animationActive)
+            {
+                // Finish the interrupted transition on resume
+                stopAnimationLoop();
+                m_relayoutPending = true;
+            }
+            m_activeExclusivePlugins.insert(ev->plugin_name);
+            refreshPreselectOverlay();
+            refreshBorders();
+        }
+        else if (m_activeExclusivePlugins.erase(ev->plugin_name) && !isSuspended())
+        {
+            resumeTiling();
+        }
+    };
+    
+    // Everything queued while suspended becomes one batched relayout
+    void resumeTiling()
+    {
+        if (!m_relayoutPending)
+        {
+            refreshPreselectOverlay();
+            refreshBorders();
+            return;
+        }
+        
+        m_relayoutPending = false;
+        updateWorkspaceBounds();
+        for (auto& [wsIndex, tree] : m_trees)
+            tree->recalculateLayout(true);
+        
+        // The overview may have moved or resized views: re-apply ours
+        for (auto tree : workspaceTrees(getCurrentWorkspaceIndex()))
+        {
+            for (auto& view : viewsShownHere(tree))
+                view->get_data_safe<ViewAnimData>()->lastScale = -1.0f;
+        }
+        
+        startAnimationLoop();
+    }
+    
+    bool m_instantRemap = false;
+    wf::wl_idle_call m_clearInstantRemap;
+    
+    void remapAllTrees()
+    {
+        m_workspaceBounds = output->workarea->get_workarea();
+        for (auto& [key, tree] : m_trees)
+            tree->remapToBounds(treeBounds(key));
+        
+        // The workarea_changed that follows sees unchanged bounds, so the
+        // pinned column has to follow here
+        placePinnedViews();
+        
+        // One configure per window on the current workspace; the others
+        // are configured when their workspace is shown
+        for (auto tree : workspaceTrees(getCurrentWorkspaceIndex()))
+        {
+            for (auto& view : viewsShownHere(tree))
+                finalizeViewGeometry(view, tree);
+        }
+        
+        refreshBorders();
+        announceLayoutChanges();
+    }
+    
+    // Handle workspace switches - apply correct geometry to views on new workspace
+    wf::signal::connection_t<wf::workspace_changed_signal> on_workspace_changed =
+        [this] (wf::workspace_changed_signal *ev)
+    {
+        m_recorder.record(TraceEvent::WORKSPACE, workspaceIndex(ev->new_viewport));
+        
+        // A span switches workspaces as a whole
+        if (m_span)
+        {
+            for (auto& member : m_span->members)
+            {
+                auto wset = member.output->wset();
+                if (member.output != output &&
+                    wset->get_current_workspace() != ev->new_viewport)
+                {
+                    wset->request_workspace(ev->new_viewport);
+                }
+            }
+            migrateSpanViews();
+        }
+        
+        // Cancel any drag operation when switching workspaces
+        if (m_dragState.isDragging)
+        {
+            cancelDrag();
+        }
+        
+        // Let a scrubbed transition run to completion on its own
+        if (m_gesture.tracking)
+        {
+            finishGestureTransition(true);
+        }
+        
+        // Each workspace has its own preselection
+        refreshPreselectOverlay();
+        
+        // Overview plugins switch workspaces themselves; leave the views
+        // to them and apply everything on resume
+        if (isSuspended())
+        {
+            m_relayoutPending = true;
+            return;
+        }
+        
+        // When switching workspaces, immediately apply final geometry
+        // to all views on the new current workspace (no animation)
+        for (auto tree : workspaceTrees(getCurrentWorkspaceIndex()))
+        {
+            for (auto& view : viewsShownHere(tree))
+            {
+                auto goalGeo = localGoal(tree, view);
+                if (goalGeo)
+                {
+                    configureToGoal(view, *goalGeo);
+                    
+                    // Reset transformer
+                    auto data = view->get_data_safe<ViewAnimData>();
+                    if (data->transformer)
+                    {
+                        data->transformer->translation_x = 0;
+                        data->transformer->translation_y = 0;
+                        data->transformer->scale_x = 1.0f;
+                        data->transformer->scale_y = 1.0f;
+                        data->transformer->alpha = 1.0f;
+                    }
+                    // Force the next animation tick to rebuild the transformer
+                    data->lastScale = -1.0f;
+                    data->lastSnappedGeometry = {
+                        static_cast<float>(goalGeo->x), static_cast<float>(goalGeo->y),
+                        static_cast<float>(goalGeo->width), static_cast<float>(goalGeo->height)
+                    };
+                    view->damage();
+                }
+            }
+        }
+        
+        refreshPreselectOverlay();
+        refreshBorders();
+    };
+    
+    // Track focused view for proper split behavior
+    wf::signal::connection_t<wf::view_focus_request_signal> on_view_focused =
+        [this] (wf::view_focus_request_signal *ev)
+    {
+        auto view = wf::toplevel_cast(ev->view);
+        if (!view)
+            return;
+        
+        m_recorder.record(TraceEvent::FOCUS);
+        
+        if (!view->has_data<ViewAnimData>())
+            return;
+        
+        auto data = view->get_data<ViewAnimData>();
+        if (!data->isTiled || data->workspaceIndex < 0)
+            return;
+        
+        if (auto tree = findTreeOfView(data))
+        {
+            m_activeZones[data->workspaceIndex] = data->zone;
+            auto previous = tree->getMonocleLeaf();
+            tree->setFocusedView(view);
+            
+            // Monocle follows focus
+            if (tree->layoutMode() == LayoutMode::MONOCLE &&
+                tree->getMonocleLeaf() != previous)
+            {
+                tree->recalculateLayout(true);
+                syncHiddenTiles(tree);
+                startAnimationLoop();
+            }
+            else if (syncHiddenTiles(tree))
+            {
+                // A background tab was focused and brought to the front
+                startAnimationLoop();
+            }
+            
+            // Move the focus ring
+            refreshBorders();
+            announceLayoutChanges();
+        }
+    };
+    
+    // Toggle monocle in the focused zone; the tree stays intact so
+    // leaving monocle restores the exact layout with one animation
+    wf::activator_callback on_toggle_monocle = [this] (const wf::activator_data_t&)
+    {
+        auto tree = activeTree();
+        if (tree->isEmpty())
+            return false;
+        
+        // Leaving monocle hands the workspace back to the automatic choice,
+        // unless that is monocle as well
+        if (tree->layoutMode() != LayoutMode::MONOCLE)
+        {
+            tree->setLayoutMode(LayoutMode::MONOCLE);
+        }
+        else
+        {
+            tree->setLayoutMode(std::nullopt);
+            if (tree->layoutMode() == LayoutMode::MONOCLE)
+                tree->setLayoutMode(LayoutMode::DWINDLE);
+        }
+        syncHiddenTiles(tree);
+        startAnimationLoop();
+        return true;
+    };
+    
+    // Disable the scene nodes of tiles hidden by monocle and of background
+    // tabs (and re-enable them when they are shown again); node enable state
+    // is a counter, so only flip views whose state actually changes.
+    // Returns whether anything changed
+    bool syncHiddenTiles(TileTree* tree)
+    {
+        auto visible = tree->getVisibleViews();
+        bool changed = false;
+        
+        for (auto& view : tree->getViews())
+        {
+            auto data = view->get_data_safe<ViewAnimData>();
+            bool hide = std::find(visible.begin(), visible.end(), view) == visible.end();
+            if (hide == data->hiddenByLayout)
+                continue;
+            
+            data->hiddenByLayout = hide;
+            wf::scene::set_node_enabled(view->get_root_node(), !hide);
+            if (!hide)
+                data->lastScale = -1.0f;
+            changed = true;
+        }
+        
+        return changed;
+    }
+    
+    // Cycle the focused tile's tab group
+    bool cycleTab(int offset)
+    {
+        auto tree = activeTree();
+        auto view = tree->getFocusedTab(offset);
+        if (!view)
+            return false;
+        
+        tree->setFocusedView(view);
+        syncHiddenTiles(tree);
+        startAnimationLoop();
+        wf::get_core().default_wm->focus_raise_view(view);
+        return true;
+    }
+    
+    wf::activator_callback on_next_tab = [this] (const wf::activator_data_t&)
+    {
+        return cycleTab(1);
+    };
+    
+    wf::activator_callback on_prev_tab = [this] (const wf::activator_data_t&)
+    {
+        return cycleTab(-1);
+    };
+    
+    // Focus the previously focused tile on the current workspace (MRU)
+    wf::activator_callback on_focus_last = [this] (const wf::activator_data_t&)
+    {
+        auto tree = findActiveTree();
+        if (!tree)
+            return false;
+        
+        auto view = tree->getPreviousFocus();
+        if (!view)
+            return false;
         
-        // Stop animation loop
-        if (m_animationActive)
-        {
-            output->render->rem_effect(&m_animationHook);
-        }
+        wf::get_core().default_wm->focus_raise_view(view);
+        return true;
+    };
+    
+    // Send a layout message to the focused zone's tree and animate to the
+    // result
+    bool sendLayoutMessage(const std::string& msg)
+    {
+        auto tree = findActiveTree();
+        if (!tree || tree->isEmpty())
+            return false;
         
-        // Disconnect core signals
-        on_pointer_motion.disconnect();
-        on_pointer_button.disconnect();
+        m_recorder.record(TraceEvent::LAYOUT_MESSAGE);
+        tree->handleLayoutMessage(msg);
+        startAnimationLoop();
+        return true;
     }
     
-  private:
-    // Animation configs per type
-    AnimationConfig m_animConfigIn;
-    AnimationConfig m_animConfigOut;
-    AnimationConfig m_animConfigMove;
+    wf::activator_callback on_toggle_pseudotile = [this] (const wf::activator_data_t&)
+    {
+        return sendLayoutMessage("pseudo");
+    };
     
-    BezierCurve m_bezier;  // Default/shared bezier
+    wf::activator_callback on_equalize = [this] (const wf::activator_data_t&)
+    {
+        return sendLayoutMessage("equalize");
+    };
     
-    // Map of workspace coordinates to tile trees
-    // Key is workspace index (y * grid_width + x)
-    std::map<int, std::unique_ptr<TileTree>> m_trees;
+    wf::activator_callback on_rotate = [this] (const wf::activator_data_t&)
+    {
+        return sendLayoutMessage("rotate");
+    };
     
-    wf::geometry_t m_workspaceBounds;
-    bool m_animationActive = false;
-    wf::point_t m_cursorPos{0, 0};
+    wf::activator_callback on_mirror_horizontal = [this] (const wf::activator_data_t&)
+    {
+        return sendLayoutMessage("mirrorh");
+    };
     
-    // Drag-to-swap state
-    DragState m_dragState;
+    wf::activator_callback on_mirror_vertical = [this] (const wf::activator_data_t&)
+    {
+        return sendLayoutMessage("mirrorv");
+    };
     
-    wf::effect_hook_t m_animationHook = [this] ()
+    wf::activator_callback on_toggle_split = [this] (const wf::activator_data_t&)
     {
-        tickAnimations();
+        return sendLayoutMessage("togglesplit");
     };
     
-    // Get workspace index from coordinates
-    int workspaceIndex(wf::point_t ws)
+    wf::activator_callback on_swap_next = [this] (const wf::activator_data_t&)
     {
-        auto grid = output->wset()->get_workspace_grid_size();
-        return ws.y * grid.width + ws.x;
-    }
+        return sendLayoutMessage("swapnext");
+    };
     
-    // Get workspace coordinates from index
-    wf::point_t workspaceCoords(int index)
+    wf::activator_callback on_swap_prev = [this] (const wf::activator_data_t&)
     {
-        auto grid = output->wset()->get_workspace_grid_size();
-        return {index % grid.width, index / grid.width};
-    }
+        return sendLayoutMessage("swapprev");
+    };
     
-    // Get total number of workspaces
-    int getTotalWorkspaces()
+    // Convert the focused zone's tree between binary and n-ary form
+    wf::activator_callback on_flatten = [this] (const wf::activator_data_t&)
     {
-        auto grid = output->wset()->get_workspace_grid_size();
-        return grid.width * grid.height;
-    }
+        return sendLayoutMessage("flatten");
+    };
     
-    // Get workspace index for a view
-    int getViewWorkspaceIndex(wayfire_toplevel_view view)
+    wf::activator_callback on_binarize = [this] (const wf::activator_data_t&)
     {
-        auto ws = output->wset()->get_view_main_workspace(view);
-        return workspaceIndex(ws);
-    }
+        return sendLayoutMessage("binarize");
+    };
     
-    // Get current workspace index
-    int getCurrentWorkspaceIndex()
+    // ============================================================================
+    // Preselection - declare where the next window will be tiled
+    // ============================================================================
+    
+    std::shared_ptr<RectOverlayNode> m_preselectOverlay;
+    
+    bool preselect(SplitDir dir, bool newFirst)
     {
-        auto ws = output->wset()->get_current_workspace();
-        return workspaceIndex(ws);
+        auto tree = activeTree();
+        auto leaf = tree->getFocusedNode();
+        if (!leaf)
+            return false;
+        
+        tree->setPreselection(leaf, dir, newFirst,
+            static_cast<float>(double(opt_preselect_ratio)));
+        refreshPreselectOverlay();
+        return true;
     }
     
-    // Find the next workspace with available space
-    // Returns -1 if all workspaces are full
-    int findNextAvailableWorkspace(int startFromIndex)
+    wf::activator_callback on_preselect_left = [this] (const wf::activator_data_t&)
     {
-        int maxWindows = opt_max_windows_per_workspace;
-        if (maxWindows <= 0)
-        {
-            // Unlimited - just use the starting workspace
-            return startFromIndex;
-        }
-        
-        int totalWorkspaces = getTotalWorkspaces();
+        return preselect(SplitDir::HORIZONTAL, true);
+    };
+    
+    wf::activator_callback on_preselect_right = [this] (const wf::activator_data_t&)
+    {
+        return preselect(SplitDir::HORIZONTAL, false);
+    };
+    
+    wf::activator_callback on_preselect_up = [this] (const wf::activator_data_t&)
+    {
+        return preselect(SplitDir::VERTICAL, true);
+    };
+    
+    wf::activator_callback on_preselect_down = [this] (const wf::activator_data_t&)
+    {
+        return preselect(SplitDir::VERTICAL, false);
+    };
+    
+    wf::activator_callback on_preselect_cancel = [this] (const wf::activator_data_t&)
+    {
+        auto tree = findActiveTree();
+        if (!tree)
+            return false;
         
-        // First, check the starting workspace
-        auto startTree = getTreeForWorkspace(startFromIndex);
-        if (startTree->getWindowCount() < maxWindows)
+        tree->clearPreselection();
+        refreshPreselectOverlay();
+        return true;
+    };
+    
+    // Show the current workspace's preselection (if any) as a translucent
+    // rectangle over the area the next window will occupy
+    void refreshPreselectOverlay()
+    {
+        std::vector<OverlayRect> rects;
+        for (auto tree : workspaceTrees(getCurrentWorkspaceIndex()))
         {
-            return startFromIndex;
+            if (auto geo = tree->getPreselectionGeometry())
+            {
+                auto offset = spanOffset();
+                rects.push_back({{geo->x + offset.x, geo->y + offset.y, geo->width, geo->height},
+                    opt_preselect_color});
+            }
         }
         
-        // Search through all workspaces starting from the next one
-        for (int i = 1; i < totalWorkspaces; i++)
+        if (rects.empty() && !m_preselectOverlay)
+            return;
+        
+        if (!m_preselectOverlay)
         {
-            int wsIndex = (startFromIndex + i) % totalWorkspaces;
-            auto tree = getTreeForWorkspace(wsIndex);
-            
-            if (tree->getWindowCount() < maxWindows)
-            {
-                return wsIndex;
-            }
+            m_preselectOverlay = std::make_shared<RectOverlayNode>();
+            wf::scene::add_front(output->node_for_layer(wf::scene::layer::OVERLAY),
+                m_preselectOverlay);
         }
         
-        // All workspaces are full - return -1 to indicate overflow
-        // Or we could fall back to current workspace (user's choice)
-        return -1;
+        m_preselectOverlay->setRects(std::move(rects));
     }
     
-    // Get or create tree for a workspace
-    TileTree* getTreeForWorkspace(int wsIndex)
+    // ============================================================================
+    // Pinned windows - a column on one side of the output, shown on every
+    // workspace; the trees of all workspaces tile the rest, so switching
+    // workspaces never reconfigures a pinned window
+    // ============================================================================
+    
+    std::vector<wayfire_toplevel_view> m_pinnedViews;
+    
+    wf::geometry_t pinnedSlot()
     {
-        auto it = m_trees.find(wsIndex);
-        if (it == m_trees.end())
-        {
-            auto tree = std::make_unique<TileTree>();
-            tree->setConfig(
-                &m_bezier,
-                static_cast<float>(int(opt_duration)),
-                opt_gaps_in,
-                opt_gaps_out,
-                opt_preserve_split,
-                static_cast<float>(double(opt_split_width_multiplier)),
-                opt_force_split,
-                opt_smart_split
-            );
-            tree->setBounds(m_workspaceBounds);
-            auto ptr = tree.get();
-            m_trees[wsIndex] = std::move(tree);
-            return ptr;
-        }
-        return it->second.get();
+        auto slot = m_workspaceBounds;
+        double fraction = std::clamp(double(opt_pin_width), 0.1, 0.5);
+        slot.width = static_cast<int>(std::lround(m_workspaceBounds.width * fraction));
+        if (toLower(opt_pin_side) != "left")
+            slot.x += m_workspaceBounds.width - slot.width;
+        return slot;
     }
     
-    // Get tree for a view (based on view's workspace)
-    TileTree* getTreeForView(wayfire_toplevel_view view)
+    // The workarea left to the trees
+    wf::geometry_t tilingArea()
     {
-        int wsIndex = getViewWorkspaceIndex(view);
-        return getTreeForWorkspace(wsIndex);
+        auto area = m_workspaceBounds;
+        if (m_pinnedViews.empty())
+            return area;
+        
+        auto slot = pinnedSlot();
+        area.width -= slot.width;
+        if (slot.x == area.x)
+            area.x += slot.width;
+        return area;
     }
     
-    void updateAnimationConfigs()
+    // Stack the pinned windows in the slot; the side facing the trees has no
+    // gap of its own, the trees' outer gap separates them
+    void placePinnedViews()
     {
-        // Default bezier curve values
-        float p1x = static_cast<float>(double(opt_bezier_p1_x));
-        float p1y = static_cast<float>(double(opt_bezier_p1_y));
-        float p2x = static_cast<float>(double(opt_bezier_p2_x));
-        float p2y = static_cast<float>(double(opt_bezier_p2_y));
-        
-        m_bezier = BezierCurve(p1x, p1y, p2x, p2y);
-        
-        // Configure each animation type
-        // Use specific durations if set, otherwise fall back to main duration
-        int durationIn = opt_duration_in > 0 ? int(opt_duration_in) : int(opt_duration);
-        int durationOut = opt_duration_out > 0 ? int(opt_duration_out) : int(opt_duration);
-        int durationMove = opt_duration_move > 0 ? int(opt_duration_move) : int(opt_duration);
+        if (m_pinnedViews.empty())
+            return;
         
-        // Helper to check if a bezier is set (non-zero values)
-        auto hasCustomBezier = [](double p1x, double p1y, double p2x, double p2y) {
-            // Consider it custom if any value is non-zero (default is 0)
-            return (p1x != 0.0 || p1y != 0.0 || p2x != 0.0 || p2y != 0.0);
+        auto slot = pinnedSlot();
+        int gapOut = opt_gaps_out;
+        int gapIn = opt_gaps_in;
+        bool left = (slot.x == m_workspaceBounds.x);
+        wf::geometry_t inner = {
+            slot.x + (left ? gapOut : 0), slot.y + gapOut,
+            std::max(1, slot.width - gapOut), std::max(1, slot.height - 2 * gapOut)
         };
         
-        // WindowsIn bezier - use custom if set, otherwise default
-        if (hasCustomBezier(opt_bezier_in_p1_x, opt_bezier_in_p1_y, 
-                           opt_bezier_in_p2_x, opt_bezier_in_p2_y))
-        {
-            m_animConfigIn.setCurve(
-                static_cast<float>(double(opt_bezier_in_p1_x)),
-                static_cast<float>(double(opt_bezier_in_p1_y)),
-                static_cast<float>(double(opt_bezier_in_p2_x)),
-                static_cast<float>(double(opt_bezier_in_p2_y))
-            );
-        }
-        else
-        {
-            m_animConfigIn.setCurve(p1x, p1y, p2x, p2y);
-        }
-        m_animConfigIn.durationMs = static_cast<float>(durationIn);
-        m_animConfigIn.popinPercent = static_cast<float>(double(opt_popin_percent));
-        
-        // WindowsOut bezier
-        if (hasCustomBezier(opt_bezier_out_p1_x, opt_bezier_out_p1_y,
-                           opt_bezier_out_p2_x, opt_bezier_out_p2_y))
-        {
-            m_animConfigOut.setCurve(
-                static_cast<float>(double(opt_bezier_out_p1_x)),
-                static_cast<float>(double(opt_bezier_out_p1_y)),
-                static_cast<float>(double(opt_bezier_out_p2_x)),
-                static_cast<float>(double(opt_bezier_out_p2_y))
-            );
-        }
-        else
+        int count = static_cast<int>(m_pinnedViews.size());
+        int height = std::max(1, (inner.height - gapIn * (count - 1)) / count);
+        for (int i = 0; i < count; i++)
         {
-            m_animConfigOut.setCurve(p1x, p1y, p2x, p2y);
+            wf::geometry_t goal = {inner.x, inner.y + i * (height + gapIn), inner.width, height};
+            m_pinnedViews[i]->get_data_safe<ViewAnimData>()->goalGeometry = goal;
+            configureToGoal(m_pinnedViews[i], goal);
         }
-        m_animConfigOut.durationMs = static_cast<float>(durationOut);
+    }
+    
+    // The slot appeared, changed or went away: every tree animates to its
+    // new bounds
+    void relayoutAroundPins()
+    {
+        updateWorkspaceBounds();
+        for (auto& [key, tree] : m_trees)
+            tree->recalculateLayout(true);
         
-        // WindowsMove bezier (resize/reposition when layout changes)
-        if (hasCustomBezier(opt_bezier_move_p1_x, opt_bezier_move_p1_y,
-                           opt_bezier_move_p2_x, opt_bezier_move_p2_y))
-        {
-            m_animConfigMove.setCurve(
-                static_cast<float>(double(opt_bezier_move_p1_x)),
-                static_cast<float>(double(opt_bezier_move_p1_y)),
-                static_cast<float>(double(opt_bezier_move_p2_x)),
-                static_cast<float>(double(opt_bezier_move_p2_y))
-            );
-        }
-        else
-        {
-            m_animConfigMove.setCurve(p1x, p1y, p2x, p2y);
-        }
-        m_animConfigMove.durationMs = static_cast<float>(durationMove);
+        startAnimationLoop();
+        refreshPreselectOverlay();
+        refreshBorders();
     }
     
-    void updateTreeConfig()
+    bool pinView(wayfire_toplevel_view view)
     {
-        // Update config for all existing trees
-        for (auto& [wsIndex, tree] : m_trees)
+        auto data = view->get_data<ViewAnimData>();
+        auto tree = findTreeOfView(data);
+        
+        // A swallowing window keeps its terminal's leaf
+        if (!tree || data->swallowedView)
+            return false;
+        
+        tree->removeView(view, true);
+        syncHiddenTiles(tree);
+        if (data->hiddenByLayout)
         {
-            tree->setConfig(
-                &m_bezier,
-                static_cast<float>(int(opt_duration)),
-                opt_gaps_in,
-                opt_gaps_out,
-                opt_preserve_split,
-                static_cast<float>(double(opt_split_width_multiplier)),
-                opt_force_split,
-                opt_smart_split
-            );
+            wf::scene::set_node_enabled(view->get_root_node(), true);
+            data->hiddenByLayout = false;
         }
+        
+        // Pinned windows never animate
+        removeTransformer(view);
+        data->isTiled = false;
+        data->workspaceIndex = -1;
+        data->pinned = true;
+        
+        view->set_sticky(true);
+        m_pinnedViews.push_back(view);
+        relayoutAroundPins();
+        return true;
     }
     
-    void updateWorkspaceBounds()
+    bool unpinView(wayfire_toplevel_view view)
     {
-        m_workspaceBounds = output->workarea->get_workarea();
-        // Update bounds for all trees
-        for (auto& [wsIndex, tree] : m_trees)
-        {
-            tree->setBounds(m_workspaceBounds);
-        }
+        m_pinnedViews.erase(std::remove(m_pinnedViews.begin(), m_pinnedViews.end(), view),
+            m_pinnedViews.end());
+        view->set_sticky(false);
+        view->get_data_safe<ViewAnimData>()->pinned = false;
+        
+        // Bounds first, so the window is tiled into the grown area
+        relayoutAroundPins();
+        int wsIndex = getCurrentWorkspaceIndex();
+        tileView(view, wsIndex, insertionZone(wsIndex));
+        return true;
     }
     
-    // Signal handlers
-    wf::signal::connection_t<wf::view_mapped_signal> on_view_mapped =
-        [this] (wf::view_mapped_signal *ev)
+    // A pinned window moved to another output leaves this output's column
+    // and is an ordinary window there
+    wf::signal::connection_t<wf::view_moved_to_wset_signal> on_view_moved_to_wset =
+        [this] (wf::view_moved_to_wset_signal *ev)
     {
-        auto view = wf::toplevel_cast(ev->view);
-        if (!view)
+        if (!ev->view || ev->old_wset != output->wset() || ev->new_wset == output->wset())
             return;
         
-        if (!opt_tile_by_default)
+        auto it = std::find(m_pinnedViews.begin(), m_pinnedViews.end(), ev->view);
+        if (it == m_pinnedViews.end())
             return;
         
-        // Update cursor position for smart_split
-        updateCursorPosition();
-        
-        // Start from the current workspace
-        int currentWsIndex = getCurrentWorkspaceIndex();
-        
-        // Find an available workspace (respecting max_windows_per_workspace)
-        int targetWsIndex = findNextAvailableWorkspace(currentWsIndex);
+        m_pinnedViews.erase(it);
+        ev->view->set_sticky(false);
+        ev->view->erase_data<ViewAnimData>();
+        relayoutAroundPins();
+    };
+    
+    void parkPinnedViews()
+    {
+        if (m_pinnedViews.empty())
+            return;
         
-        if (targetWsIndex < 0)
+        for (auto& view : m_pinnedViews)
         {
-            // All workspaces are full - fall back to current workspace anyway
-            // (The user has more windows than workspace capacity allows)
-            targetWsIndex = currentWsIndex;
+            view->set_sticky(false);
+            view->erase_data<ViewAnimData>();
         }
         
-        // Get the tree for the target workspace
-        auto tree = getTreeForWorkspace(targetWsIndex);
+        auto parked = wf::get_core().get_data_safe<ParkedLayouts>();
+        parked->pinned[ParkedLayouts::outputKey(output)] = std::move(m_pinnedViews);
+        m_pinnedViews.clear();
+    }
+    
+    // Re-pin the windows parked for this output; returns whether any were
+    bool adoptParkedPins(ParkedLayouts& parked)
+    {
+        auto it = parked.pinned.find(ParkedLayouts::outputKey(output));
+        if (it == parked.pinned.end())
+            return false;
         
-        // Track the newly mapped view as focused (it typically gets focus)
-        tree->setFocusedView(view);
+        auto views = std::move(it->second);
+        parked.pinned.erase(it);
         
-        // If we're placing on a different workspace, move the view there 
-        // and switch to that workspace so the user sees the new window
-        if (targetWsIndex != currentWsIndex)
+        // A span has no single side to pin to
+        if (m_span)
+            return false;
+        
+        for (auto& view : views)
         {
-            auto targetCoords = workspaceCoords(targetWsIndex);
+            if (!view->is_mapped() || view->has_data<ViewAnimData>())
+                continue;
             
-            // First, switch the user's view to the target workspace
-            output->wset()->request_workspace(targetCoords);
-            
-            // The view will be on the current workspace initially, 
-            // but since we're switching workspaces, we need to move it
-            output->wset()->move_to_workspace(view, targetCoords);
+            if (view->get_output() != output)
+                wf::move_view_to_output(view, output, false);
+            view->get_data_safe<ViewAnimData>()->pinned = true;
+            view->set_sticky(true);
+            m_pinnedViews.push_back(view);
         }
+        return !m_pinnedViews.empty();
+    }
+    
+    wf::activator_callback on_toggle_pin = [this] (const wf::activator_data_t&)
+    {
+        // A span has no single side to pin to
+        if (m_span)
+            return false;
+        
+        auto view = wf::toplevel_cast(wf::get_core().seat->get_active_view());
+        if (!view || view->get_output() != output || !view->has_data<ViewAnimData>())
+            return false;
         
-        tileView(view, targetWsIndex);
+        auto data = view->get_data<ViewAnimData>();
+        if (data->pinned)
+            return unpinView(view);
+        return data->isTiled && pinView(view);
     };
     
-    wf::signal::connection_t<wf::view_unmapped_signal> on_view_unmapped =
-        [this] (wf::view_unmapped_signal *ev)
+    // ============================================================================
+    // Borders - every tile border and the focus ring of the current workspace
+    // are rectangles of one scene node, drawn in a single pass behind the
+    // views (so they show in the gaps)
+    // ============================================================================
+    
+    std::shared_ptr<RectOverlayNode> m_borderNode;
+    
+    // Rebuild the border strips from the geometry the last tick applied to
+    // each view; the node damages only strips that moved or recolored
+    void refreshBorders()
     {
-        auto view = wf::toplevel_cast(ev->view);
-        if (!view)
-            return;
-        
-        // Cancel any drag operation involving this view
-        if (m_dragState.isDragging && m_dragState.draggedView == view)
-        {
-            m_dragState.reset();
-        }
+        // Views are transformed by an overview plugin; borders would not match
+        int width = isSuspended() ? 0 : int(opt_border_width);
+        std::vector<OverlayRect> rects;
         
-        // Get the workspace index from the view's stored data
-        if (view->has_data<ViewAnimData>())
+        // Only the focused zone shows a focus ring
+        auto focusedTree = findActiveTree();
+        for (auto tree : workspaceTrees(getCurrentWorkspaceIndex()))
         {
-            auto data = view->get_data<ViewAnimData>();
-            if (data->isTiled && data->workspaceIndex >= 0)
+            if (width <= 0)
+                break;
+            
+            auto focused = (tree == focusedTree) ? tree->getFocusedNode() : nullptr;
+            
+            for (auto& view : viewsShownHere(tree))
             {
-                auto it = m_trees.find(data->workspaceIndex);
-                if (it != m_trees.end() && it->second->hasView(view))
-                {
-                    untileView(view, it->second.get());
-                    return;
-                }
+                auto data = view->get_data<ViewAnimData>();
+                if (!data || data->lastSnappedGeometry.width <= 0)
+                    continue;
+                
+                // Follow the popin/popout scale around the tile center
+                auto g = data->lastSnappedGeometry;
+                float scale = (data->lastScale > 0.0f) ? data->lastScale : 1.0f;
+                float cx = g.x + g.width / 2.0f;
+                float cy = g.y + g.height / 2.0f;
+                wf::geometry_t box = {
+                    static_cast<int>(std::lround(cx - g.width * scale / 2.0f)),
+                    static_cast<int>(std::lround(cy - g.height * scale / 2.0f)),
+                    static_cast<int>(std::lround(g.width * scale)),
+                    static_cast<int>(std::lround(g.height * scale))
+                };
+                
+                wf::color_t color = (focused && focused->view() == view)
+                    ? opt_border_color_active : opt_border_color_inactive;
+                color.a *= data->lastAlpha;
+                
+                rects.push_back({{box.x - width, box.y - width, box.width + 2 * width, width}, color});
+                rects.push_back({{box.x - width, box.y + box.height, box.width + 2 * width, width}, color});
+                rects.push_back({{box.x - width, box.y, width, box.height}, color});
+                rects.push_back({{box.x + box.width, box.y, width, box.height}, color});
             }
         }
         
-        // Fallback: search all trees for this view
-        for (auto& [wsIndex, tree] : m_trees)
+        if (rects.empty() && !m_borderNode)
+            return;
+        
+        if (!m_borderNode)
         {
-            if (tree->hasView(view))
-            {
-                untileView(view, tree.get());
-                return;
-            }
+            m_borderNode = std::make_shared<RectOverlayNode>();
+            wf::scene::add_back(output->node_for_layer(wf::scene::layer::WORKSPACE),
+                m_borderNode);
         }
-    };
+        
+        m_borderNode->setRects(std::move(rects));
+    }
     
-    wf::signal::connection_t<wf::workarea_changed_signal> on_workarea_changed =
-        [this] (wf::workarea_changed_signal*)
+    // ============================================================================
+    // Performance HUD - tick time graph and live counters in one overlay
+    // node; only the HUD's own rectangle is ever damaged
+    // ============================================================================
+    
+    static constexpr int HUD_WIDTH = 248;
+    static constexpr int HUD_GRAPH_HEIGHT = 64;
+    static constexpr int HUD_MARGIN = 16;
+    
+    std::shared_ptr<RectOverlayNode> m_hudNode;
+    std::array<uint32_t, 116> m_hudTicks{};  // Tick time (us), 2 px per frame
+    size_t m_hudNextTick = 0;
+    std::optional<AnimClock::time_point> m_dragMotionTime;
+    int m_dragLatencyUs = -1;
+    int m_hudChannels = 0;         // Sampled by rollSecond()
+    TileNodeWeak m_hudDropTarget;  // Target m_hudDropIndex was looked up for
+    int m_hudDropIndex = -1;
+    std::vector<OverlayRect> m_hudRects;
+    
+    // Set by a new tick sample, the one-second roll and drag motion; the
+    // HUD is rebuilt on the next frame only then
+    bool m_hudDirty = false;
+    
+    wf::effect_hook_t m_hudHook = [this] ()
     {
-        updateWorkspaceBounds();
-        // Recalculate layout for all trees
-        for (auto& [wsIndex, tree] : m_trees)
-        {
-            tree->setBounds(m_workspaceBounds);
-            tree->recalculateLayout(true);
-        }
-        startAnimationLoop();
+        refreshHud();
     };
     
-    // Handle workspace switches - apply correct geometry to views on new workspace
-    wf::signal::connection_t<wf::workspace_changed_signal> on_workspace_changed =
-        [this] (wf::workspace_changed_signal*)
+    void setHudVisible(bool visible)
     {
-        // Cancel any drag operation when switching workspaces
-        if (m_dragState.isDragging)
+        if (visible == bool(m_hudNode))
+            return;
+        
+        if (visible)
         {
-            cancelDrag();
+            m_hudNode = std::make_shared<RectOverlayNode>();
+            wf::scene::add_front(output->node_for_layer(wf::scene::layer::OVERLAY), m_hudNode);
+            output->render->add_effect(&m_hudHook, wf::OUTPUT_EFFECT_PRE);
+            m_hudDirty = true;
+            refreshHud();
         }
-        
-        // When switching workspaces, immediately apply final geometry
-        // to all views on the new current workspace (no animation)
-        int currentWs = getCurrentWorkspaceIndex();
-        auto it = m_trees.find(currentWs);
-        if (it != m_trees.end())
+        else
         {
-            for (auto& view : it->second->getViews())
-            {
-                auto goalGeo = it->second->getViewGoalGeometry(view);
-                if (goalGeo)
-                {
-                    view->set_geometry(*goalGeo);
-                    
-                    // Reset transformer
-                    auto data = view->get_data_safe<ViewAnimData>();
-                    if (data->transformer)
-                    {
-                        data->transformer->translation_x = 0;
-                        data->transformer->translation_y = 0;
-                        data->transformer->scale_x = 1.0f;
-                        data->transformer->scale_y = 1.0f;
-                        data->transformer->alpha = 1.0f;
-                    }
-                    view->damage();
-                }
-            }
+            output->render->rem_effect(&m_hudHook);
+            m_hudNode->setRects({});
+            wf::scene::remove_child(m_hudNode);
+            m_hudNode = nullptr;
         }
+        updateSecondTimer();
+    }
+    
+    wf::activator_callback on_toggle_hud = [this] (const wf::activator_data_t&)
+    {
+        setHudVisible(!m_hudNode);
+        return true;
     };
     
-    // Track focused view for proper split behavior
-    wf::signal::connection_t<wf::view_focus_request_signal> on_view_focused =
-        [this] (wf::view_focus_request_signal *ev)
+    // Checked on every frame the output renders, rebuilt only when dirty:
+    // the graph scrolls when animation frames add samples and the counters
+    // change once per second or while dragging
+    void refreshHud()
     {
-        auto view = wf::toplevel_cast(ev->view);
-        if (!view)
+        if (!m_hudNode || !m_hudDirty)
             return;
+        m_hudDirty = false;
         
-        if (!view->has_data<ViewAnimData>())
-            return;
+        // Pointer motion to the next frame while dragging
+        if (m_dragMotionTime)
+        {
+            m_dragLatencyUs = static_cast<int>(std::chrono::duration_cast<
+                std::chrono::microseconds>(AnimClock::now() - *m_dragMotionTime).count());
+            m_dragMotionTime.reset();
+        }
         
-        auto data = view->get_data<ViewAnimData>();
-        if (!data->isTiled || data->workspaceIndex < 0)
-            return;
+        auto period = m_refreshPeriod;
+        if (period.count() <= 0 && output->handle->refresh > 0)
+            period = std::chrono::nanoseconds(1'000'000'000'000LL / output->handle->refresh);
+        float budgetUs = (period.count() > 0) ? period.count() / 1000.0f : 16667.0f;
+        
+        auto workarea = output->workarea->get_workarea();
+        int x0 = workarea.x + workarea.width - HUD_WIDTH - HUD_MARGIN;
+        int y0 = workarea.y + HUD_MARGIN;
+        int rowHeight = 20;
+        int height = 8 + HUD_GRAPH_HEIGHT + 8 + 4 * rowHeight + 4;
+        
+        auto& rects = m_hudRects;
+        rects.clear();
+        rects.push_back({{x0, y0, HUD_WIDTH, height}, {0.0, 0.0, 0.0, 0.7}});
+        
+        // Tick time, oldest on the left; full height is two frame budgets
+        int graphX = x0 + 8;
+        int graphBottom = y0 + 8 + HUD_GRAPH_HEIGHT;
+        size_t samples = m_hudTicks.size();
+        for (size_t i = 0; i < samples; i++)
+        {
+            uint32_t us = m_hudTicks[(m_hudNextTick + i) % samples];
+            float fraction = std::min(1.0f, us / (2.0f * budgetUs));
+            int barHeight = std::max(1, static_cast<int>(fraction * HUD_GRAPH_HEIGHT));
+            wf::color_t color = (us < budgetUs / 2) ? wf::color_t{0.3, 0.9, 0.4, 0.9}
+                : (us < budgetUs) ? wf::color_t{1.0, 0.8, 0.2, 0.9} : wf::color_t{1.0, 0.3, 0.3, 0.9};
+            rects.push_back({{graphX + static_cast<int>(i) * 2, graphBottom - barHeight, 2, barHeight}, color});
+        }
+        
+        // The frame budget
+        rects.push_back({{graphX, graphBottom - HUD_GRAPH_HEIGHT / 2, static_cast<int>(samples) * 2, 1},
+            {1.0, 1.0, 1.0, 0.5}});
+        
+        // Rows: a colored key, then the figure
+        const std::pair<int, wf::color_t> rows[] = {
+            {m_hudChannels, {0.4, 0.6, 1.0, 1.0}},                        // Animating channels
+            {static_cast<int>(m_configuresPerSecond), {1.0, 0.8, 0.2, 1.0}},  // Configures, last second
+            {hudDropTargetIndex(), {0.2, 0.9, 0.9, 1.0}},                // Drop target tile (1-based)
+            {m_dragLatencyUs, {0.9, 0.4, 0.9, 1.0}},                     // Drag latency (us)
+        };
         
-        auto it = m_trees.find(data->workspaceIndex);
-        if (it != m_trees.end())
+        int rowY = graphBottom + 8;
+        for (auto& [value, color] : rows)
         {
-            it->second->setFocusedView(view);
+            rects.push_back({{x0 + 8, rowY + 3, 8, 8}, color});
+            appendSevenSegment(rects, value, {x0 + 24, rowY}, {1.0, 1.0, 1.0, 0.9});
+            rowY += rowHeight;
         }
-    };
+        
+        m_hudNode->swapRects(rects);
+    }
+    
+    // Position of the current drop target in its tree, or -1; looked up
+    // again only when the target changes
+    int hudDropTargetIndex()
+    {
+        auto target = m_currentDropTarget ? m_currentDropTarget : m_dragState.currentDropTarget;
+        if (!target)
+        {
+            m_hudDropTarget.reset();
+            return m_hudDropIndex = -1;
+        }
+        if (m_hudDropTarget.lock() == target)
+            return m_hudDropIndex;
+        
+        m_hudDropTarget = target;
+        m_hudDropIndex = -1;
+        auto tree = (m_drag_impl && m_drag_impl->tree) ? m_drag_impl->tree : findActiveTree();
+        if (!target->view() || !tree)
+            return m_hudDropIndex;
+        
+        auto views = tree->getViews();
+        auto it = std::find(views.begin(), views.end(), target->view());
+        if (it != views.end())
+            m_hudDropIndex = static_cast<int>(it - views.begin()) + 1;
+        return m_hudDropIndex;
+    }
     
     // ============================================================================
     // Input Grab for Drag-to-Swap
@@ -1723,7 +5587,9 @@ class AnimatedTilePlugin : public wf::per_output_plugin_instance_t
             
             if (threshold_exceeded && tree)
             {
-                tree->setCursorPosition(cursor);
+                tree->setCursorPosition(plugin->cursorInTree(cursor));
+                plugin->m_dragMotionTime = AnimClock::now();
+                plugin->m_hudDirty = true;
                 plugin->update_drop_target(cursor);
             }
         }
@@ -1767,6 +5633,7 @@ class AnimatedTilePlugin : public wf::per_output_plugin_instance_t
         m_drag_impl.reset();
         m_currentDropTarget = nullptr;
         m_sourceWorkspaceIndex = -1;
+        m_hudDirty = true;
     }
 
     void update_drop_target(wf::point_t cursor)
@@ -1774,7 +5641,7 @@ class AnimatedTilePlugin : public wf::per_output_plugin_instance_t
         if (!m_drag_impl || !m_drag_impl->tree)
             return;
         
-        auto targetNode = m_drag_impl->tree->findNodeAtPoint(cursor);
+        auto targetNode = m_drag_impl->tree->findNodeAtPoint(cursorInTree(cursor));
         
         if (targetNode && targetNode->isLeaf() && 
             targetNode != m_drag_impl->dragged_node &&
@@ -1811,7 +5678,7 @@ class AnimatedTilePlugin : public wf::per_output_plugin_instance_t
         if (!m_drag_impl->tree)
             return;
         
-        auto dropTarget = m_drag_impl->tree->findNodeAtPoint(cursor_pt);
+        auto dropTarget = m_drag_impl->tree->findNodeAtPoint(cursorInTree(cursor_pt));
         
         if (dropTarget && dropTarget->isLeaf() && 
             dropTarget != m_drag_impl->dragged_node &&
@@ -1845,11 +5712,10 @@ class AnimatedTilePlugin : public wf::per_output_plugin_instance_t
         if (!data->isTiled || data->workspaceIndex < 0)
             return;
         
-        auto it = m_trees.find(data->workspaceIndex);
-        if (it == m_trees.end())
+        auto tree = findTreeOfView(data);
+        if (!tree)
             return;
         
-        auto tree = it->second.get();
         auto node = tree->getNodeForView(view);
         if (!node)
             return;
@@ -1889,9 +5755,9 @@ class AnimatedTilePlugin : public wf::per_output_plugin_instance_t
             return;
         
         auto tree = it->second.get();
-        tree->setCursorPosition(m_cursorPos);
+        tree->setCursorPosition(cursorInTree(m_cursorPos));
         
-        auto targetNode = tree->findNodeAtPoint(m_cursorPos);
+        auto targetNode = tree->findNodeAtPoint(cursorInTree(m_cursorPos));
         
         // Update drop target for visual feedback
         if (targetNode && targetNode->isLeaf() && targetNode != m_dragState.draggedNode)
@@ -1928,119 +5794,369 @@ class AnimatedTilePlugin : public wf::per_output_plugin_instance_t
     {
         if (!m_dragState.isDragging || !m_dragState.draggedView)
         {
-            m_dragState.reset();
-            return;
+            m_dragState.reset();
+            return;
+        }
+        
+        updateCursorPosition();
+        
+        auto it = m_trees.find(m_dragState.sourceWorkspaceIndex);
+        if (it == m_trees.end())
+        {
+            cancelDrag();
+            return;
+        }
+        
+        auto tree = it->second.get();
+        tree->setCursorPosition(cursorInTree(m_cursorPos));
+        
+        // Check drag distance
+        int dx = std::abs(m_cursorPos.x - m_dragState.dragStartCursor.x);
+        int dy = std::abs(m_cursorPos.y - m_dragState.dragStartCursor.y);
+        int threshold = opt_drag_threshold > 0 ? int(opt_drag_threshold) : 10;
+        
+        if (dx < threshold && dy < threshold)
+        {
+            cancelDrag();
+            return;
+        }
+        
+        // Find drop target
+        auto dropTarget = tree->findNodeAtPoint(cursorInTree(m_cursorPos));
+        
+        if (dropTarget && dropTarget->isLeaf() && 
+            dropTarget != m_dragState.draggedNode &&
+            dropTarget->view() && 
+            dropTarget->view() != m_dragState.draggedView)
+        {
+            // Valid drop target - swap the windows
+            tree->swapNodes(m_dragState.draggedNode, dropTarget);
+            m_dragState.reset();
+            startAnimationLoop();
+        }
+        else
+        {
+            cancelDrag();
+        }
+        
+        output->render->damage_whole();
+    }
+    
+    void cancelDrag()
+    {
+        if (!m_dragState.isDragging)
+            return;
+        
+        // Return window to original tiled position
+        if (m_dragState.draggedView && m_dragState.sourceWorkspaceIndex >= 0)
+        {
+            auto it = m_trees.find(m_dragState.sourceWorkspaceIndex);
+            if (it != m_trees.end())
+            {
+                // Recalculate to restore proper positions
+                it->second->recalculateLayout(true);
+                startAnimationLoop();
+            }
+        }
+        
+        m_dragState.reset();
+        output->render->damage_whole();
+    }
+    
+    // ============================================================================
+    // Touchpad Gestures - 1:1 scrubbing of layout transitions
+    // ============================================================================
+    
+    // Held for the whole swipe, so other swipe plugins (expo, vswipe) don't
+    // act on the same gesture and clients don't see it
+    wf::plugin_activation_data_t m_gestureActivation{
+        .name = "animated-tile",
+        .capabilities = wf::CAPABILITY_MANAGE_COMPOSITOR,
+        .cancel = [this] () { finishGestureTransition(false); },
+    };
+    std::unique_ptr<wf::input_grab_t> m_gestureGrab;
+    
+    bool grabGesture()
+    {
+        if (!output->activate_plugin(&m_gestureActivation))
+            return false;
+        
+        m_gestureGrab = std::make_unique<wf::input_grab_t>("animated-tile-gesture", output,
+            nullptr, nullptr, nullptr);
+        m_gestureGrab->grab_input(wf::scene::layer::OVERLAY);
+        return true;
+    }
+    
+    void releaseGesture()
+    {
+        m_gesture.reset();
+        if (m_gestureGrab)
+        {
+            m_gestureGrab->ungrab_input();
+            m_gestureGrab.reset();
+            output->deactivate_plugin(&m_gestureActivation);
+        }
+    }
+    
+    wf::signal::connection_t<wf::input_event_signal<wlr_pointer_swipe_begin_event>> on_swipe_begin =
+        [this] (wf::input_event_signal<wlr_pointer_swipe_begin_event> *ev)
+    {
+        int fingers = opt_gesture_fingers;
+        if (fingers <= 0 || static_cast<int>(ev->event->fingers) != fingers)
+            return;
+        
+        if (wf::get_core().seat->get_active_output() != output)
+            return;
+        
+        if (m_gesture.tracking)
+            finishGestureTransition(true);
+        
+        if (!output->can_activate_plugin(&m_gestureActivation) || !grabGesture())
+            return;
+        
+        m_gesture.reset();
+        m_gesture.tracking = true;
+        m_gesture.lastTimeMs = ev->event->time_msec;
+    };
+    
+    wf::signal::connection_t<wf::input_event_signal<wlr_pointer_swipe_update_event>> on_swipe_update =
+        [this] (wf::input_event_signal<wlr_pointer_swipe_update_event> *ev)
+    {
+        if (!m_gesture.tracking)
+            return;
+        
+        m_gesture.delta.x += ev->event->dx;
+        m_gesture.delta.y += ev->event->dy;
+        
+        if (m_gesture.action == GestureState::Action::NONE)
+        {
+            // Wait for a clear direction before committing to a transition
+            const double directionThreshold = 10.0;
+            if (std::hypot(m_gesture.delta.x, m_gesture.delta.y) < directionThreshold)
+                return;
+            
+            bool horizontal = std::abs(m_gesture.delta.x) >= std::abs(m_gesture.delta.y);
+            double along = horizontal ? m_gesture.delta.x : m_gesture.delta.y;
+            m_gesture.sign = (along < 0) ? -1.0f : 1.0f;
+            
+            auto action = horizontal ? GestureState::Action::SWAP
+                                     : GestureState::Action::TOGGLE_SPLIT;
+            if (!beginGestureTransition(action))
+            {
+                releaseGesture();
+                return;
+            }
+            
+            m_gesture.lastTimeMs = ev->event->time_msec;
+        }
+        
+        double along = (m_gesture.action == GestureState::Action::SWAP)
+            ? m_gesture.delta.x : m_gesture.delta.y;
+        float distance = std::max(1, int(opt_gesture_distance));
+        float progress = std::clamp(
+            static_cast<float>(along * m_gesture.sign) / distance, 0.0f, 1.0f);
+        
+        // Smoothed progress velocity for the velocity-matched release
+        uint32_t dt = ev->event->time_msec - m_gesture.lastTimeMs;
+        if (dt > 0)
+        {
+            float instant = (progress - m_gesture.progress) / dt;
+            m_gesture.velocity = 0.5f * m_gesture.velocity + 0.5f * instant;
+            m_gesture.lastTimeMs = ev->event->time_msec;
         }
         
-        updateCursorPosition();
+        // Input-rate update: no relayout, only a lerp per channel
+        m_gesture.progress = progress;
+        m_gesture.tree->scrub(progress);
+        startAnimationLoop();
+    };
+    
+    wf::signal::connection_t<wf::input_event_signal<wlr_pointer_swipe_end_event>> on_swipe_end =
+        [this] (wf::input_event_signal<wlr_pointer_swipe_end_event> *ev)
+    {
+        if (!m_gesture.tracking)
+            return;
         
-        auto it = m_trees.find(m_dragState.sourceWorkspaceIndex);
-        if (it == m_trees.end())
+        if (m_gesture.action == GestureState::Action::NONE)
         {
-            cancelDrag();
+            releaseGesture();
             return;
         }
         
-        auto tree = it->second.get();
-        tree->setCursorPosition(m_cursorPos);
+        // Complete when past halfway or flung forward, unless flung back
+        const float flingVelocity = 0.002f;
+        bool commit = !ev->event->cancelled &&
+            m_gesture.velocity > -flingVelocity &&
+            (m_gesture.progress >= 0.5f || m_gesture.velocity >= flingVelocity);
         
-        // Check drag distance
-        int dx = std::abs(m_cursorPos.x - m_dragState.dragStartCursor.x);
-        int dy = std::abs(m_cursorPos.y - m_dragState.dragStartCursor.y);
-        int threshold = opt_drag_threshold > 0 ? int(opt_drag_threshold) : 10;
+        finishGestureTransition(commit);
+    };
+    
+    // Apply the structural change once and freeze the resulting transition
+    bool beginGestureTransition(GestureState::Action action)
+    {
+        auto tree = activeTree();
+        auto node = tree->getFocusedNode();
+        if (!node || !node->parent())
+            return false;
         
-        if (dx < threshold && dy < threshold)
+        if (action == GestureState::Action::SWAP &&
+            (!node->sibling() || !node->sibling()->isLeaf()))
         {
-            cancelDrag();
-            return;
+            return false;
         }
         
-        // Find drop target
-        auto dropTarget = tree->findNodeAtPoint(m_cursorPos);
+        m_gesture.action = action;
+        m_gesture.tree = tree;
+        m_gesture.node = node;
+        applyGestureStructure(true);
         
-        if (dropTarget && dropTarget->isLeaf() && 
-            dropTarget != m_dragState.draggedNode &&
-            dropTarget->view() && 
-            dropTarget->view() != m_dragState.draggedView)
+        // Layout is computed exactly once, at gesture start
+        tree->recalculateLayout(true);
+        tree->beginScrub();
+        m_recorder.record(TraceEvent::GESTURE, 1);
+        startAnimationLoop();
+        return true;
+    }
+    
+    void applyGestureStructure(bool forward)
+    {
+        auto& g = m_gesture;
+        if (g.action == GestureState::Action::SWAP)
         {
-            // Valid drop target - swap the windows
-            tree->swapNodes(m_dragState.draggedNode, dropTarget);
-            m_dragState.reset();
-            startAnimationLoop();
+            if (forward)
+                g.partner = g.node->sibling();
+            if (g.partner && g.partner->isLeaf())
+                g.tree->swapNodes(g.node, g.partner, true);
         }
-        else
+        else if (g.action == GestureState::Action::TOGGLE_SPLIT)
         {
-            cancelDrag();
+            if (forward)
+            {
+                g.partner = g.node->parent();
+                g.prevSplitLocked = g.partner->isSplitLocked();
+            }
+            
+            SplitDir newDir = (g.partner->splitDir() == SplitDir::HORIZONTAL)
+                ? SplitDir::VERTICAL
+                : SplitDir::HORIZONTAL;
+            g.partner->setSplitDir(newDir);
+            g.partner->setSplitLocked(forward ? true : g.prevSplitLocked);
         }
-        
-        output->render->damage_whole();
     }
     
-    void cancelDrag()
+    // Release the scrubbed transition into a velocity-matched completion,
+    // or undo the structural change and slide back
+    void finishGestureTransition(bool commit)
     {
-        if (!m_dragState.isDragging)
+        auto& g = m_gesture;
+        if (!g.tree || g.action == GestureState::Action::NONE)
+        {
+            releaseGesture();
             return;
+        }
         
-        // Return window to original tiled position
-        if (m_dragState.draggedView && m_dragState.sourceWorkspaceIndex >= 0)
+        m_recorder.record(TraceEvent::GESTURE, 0, commit);
+        
+        float speed = std::abs(g.velocity);
+        if (commit)
         {
-            auto it = m_trees.find(m_dragState.sourceWorkspaceIndex);
-            if (it != m_trees.end())
-            {
-                // Recalculate to restore proper positions
-                it->second->recalculateLayout(true);
-                startAnimationLoop();
-            }
+            g.tree->releaseScrub(gestureReleaseDuration(1.0f - g.progress, speed));
+        }
+        else
+        {
+            // The way back is a fresh transition covering `progress` of the
+            // original distance, so rescale the speed into its units
+            applyGestureStructure(false);
+            g.tree->recalculateLayout(true);
+            float backSpeed = (g.progress > 0.0f) ? speed / g.progress : 0.0f;
+            g.tree->releaseScrub(gestureReleaseDuration(1.0f, backSpeed));
         }
         
-        m_dragState.reset();
-        output->render->damage_whole();
+        releaseGesture();
+        startAnimationLoop();
+    }
+    
+    float gestureReleaseDuration(float remaining, float speed)
+    {
+        float maxMs = std::max(1.0f, static_cast<float>(int(opt_duration)));
+        if (speed <= 0.0f)
+            return remaining * maxMs;
+        
+        // Quadratic ease-out starts at 2x its average speed
+        return std::clamp(2.0f * remaining / speed, std::min(50.0f, maxMs), maxMs);
     }
     
     void updateCursorPosition()
     {
         auto cursor = wf::get_core().get_cursor_position();
         m_cursorPos = {static_cast<int>(cursor.x), static_cast<int>(cursor.y)};
-        // Update cursor position for current workspace tree
-        int wsIndex = getCurrentWorkspaceIndex();
-        if (m_trees.count(wsIndex))
+        // Update cursor position for current workspace trees
+        for (auto tree : workspaceTrees(getCurrentWorkspaceIndex()))
         {
-            m_trees[wsIndex]->setCursorPosition(m_cursorPos);
+            tree->setCursorPosition(cursorInTree(m_cursorPos));
         }
     }
     
-    void tileView(wayfire_toplevel_view view, int wsIndex)
+    void tileView(wayfire_toplevel_view view, int wsIndex, int zone)
     {
-        // Get the tree for this workspace
-        auto tree = getTreeForWorkspace(wsIndex);
+        // Get the tree for this workspace zone
+        auto tree = getTreeForWorkspace(wsIndex, zone);
         
         // Add to tree with animation
         tree->addView(view, true);
         
+        // Configure the final size right away rather than on the first tick
+        // (unless an overview plugin owns the views at the moment)
+        auto goalGeo = localGoal(tree, view);
+        if (goalGeo && !isSuspended())
+            configureToGoal(view, *goalGeo);
+        
         // Mark as tiled and store workspace index
         auto data = view->get_data_safe<ViewAnimData>();
         data->isTiled = true;
         data->currentAnimType = AnimationType::WINDOW_IN;
         data->workspaceIndex = wsIndex;
+        data->zone = zone;
         
         // Create transformer for animation
         ensureTransformer(view);
         
+        // A pending preselection may just have been consumed
+        refreshPreselectOverlay();
+        
+        // In monocle the new (focused) window replaces the shown tile; a
+        // window that became a tab hides the previously active one
+        syncHiddenTiles(tree);
+        
         // Start animation loop
         startAnimationLoop();
     }
     
     void untileView(wayfire_toplevel_view view, TileTree* tree)
     {
+        // A swallowing view hands its leaf back to the hidden terminal
+        if (restoreSwallowedView(view, tree))
+            return;
+        
         // Set animation type to OUT before removing
         if (view->has_data<ViewAnimData>())
         {
             auto data = view->get_data<ViewAnimData>();
             data->currentAnimType = AnimationType::WINDOW_OUT;
+            
+            // A window leaving the tree must not stay hidden
+            if (data->hiddenByLayout)
+            {
+                wf::scene::set_node_enabled(view->get_root_node(), true);
+                data->hiddenByLayout = false;
+            }
         }
         
         // Remove from tree with animation
         tree->removeView(view, true);
+        refreshPreselectOverlay();
+        syncHiddenTiles(tree);
         
         // Remove transformer
         removeTransformer(view);
@@ -2056,6 +6172,158 @@ class AnimatedTilePlugin : public wf::per_output_plugin_instance_t
         {
             startAnimationLoop();
         }
+        
+        refreshBorders();
+        announceLayoutChanges();
+    }
+    
+    // ============================================================================
+    // Terminal Swallowing
+    // ============================================================================
+    
+    static pid_t getViewPid(wayfire_toplevel_view view)
+    {
+        auto client = view->get_client();
+        if (!client)
+            return -1;
+        
+        pid_t pid = -1;
+        uid_t uid;
+        gid_t gid;
+        wl_client_get_credentials(client, &pid, &uid, &gid);
+        return pid;
+    }
+    
+    // If one of the view's ancestor processes is a tiled terminal, put the
+    // view into that terminal's leaf and hide the terminal
+    bool trySwallow(wayfire_toplevel_view view)
+    {
+        auto terminalIds = splitList(opt_swallow_terminals);
+        for (auto& id : terminalIds)
+            id = toLower(id);
+        
+        // pid -> tiled terminal windows of that process with their tree
+        // keys; single-instance terminals have many windows per pid
+        std::map<pid_t, std::vector<std::pair<wayfire_toplevel_view, int>>> terminals;
+        for (auto& [key, tree] : m_trees)
+        {
+            for (auto& candidate : tree->getViews())
+            {
+                auto appId = toLower(candidate->get_app_id());
+                if (std::find(terminalIds.begin(), terminalIds.end(), appId) == terminalIds.end())
+                    continue;
+                
+                pid_t pid = getViewPid(candidate);
+                if (pid > 0)
+                    terminals[pid].push_back({candidate, key});
+            }
+        }
+        
+        if (terminals.empty())
+            return false;
+        
+        // Walk up the process tree (shell, launcher wrappers, ...)
+        pid_t pid = getViewPid(view);
+        for (int depth = 0; depth < 16 && pid > 1; depth++)
+        {
+            pid = getParentPid(pid);
+            auto it = terminals.find(pid);
+            if (it != terminals.end())
+            {
+                auto [terminal, key] = pickSwallowedTerminal(it->second);
+                swallow(terminal, view, key);
+                return true;
+            }
+        }
+        
+        return false;
+    }
+    
+    // The window the launch most likely came from: one in the focused zone
+    // first, then the most recently focused
+    std::pair<wayfire_toplevel_view, int> pickSwallowedTerminal(
+        const std::vector<std::pair<wayfire_toplevel_view, int>>& candidates)
+    {
+        auto focusedTree = findActiveTree();
+        auto score = [&] (const std::pair<wayfire_toplevel_view, int>& c)
+        {
+            auto tree = m_trees[c.second].get();
+            return std::make_pair(tree != focusedTree, tree->focusRank(c.first));
+        };
+        
+        return *std::min_element(candidates.begin(), candidates.end(),
+            [&] (const auto& a, const auto& b) { return score(a) < score(b); });
+    }
+    
+    void swallow(wayfire_toplevel_view terminal, wayfire_toplevel_view view, int key)
+    {
+        int wsIndex = keyWorkspace(key);
+        auto tree = getTreeForWorkspace(wsIndex, keyZone(key));
+        auto leaf = tree->replaceView(terminal, view);
+        if (!leaf)
+            return;
+        
+        if (getViewWorkspaceIndex(view) != wsIndex)
+            output->wset()->move_to_workspace(view, workspaceCoords(wsIndex));
+        
+        hideSwallowedTerminal(terminal, view);
+        
+        auto data = view->get_data_safe<ViewAnimData>();
+        data->isTiled = true;
+        data->currentAnimType = AnimationType::WINDOW_IN;
+        data->workspaceIndex = wsIndex;
+        data->zone = keyZone(key);
+        
+        tree->setFocusedView(view);
+        ensureTransformer(view);
+        
+        // Same goal geometry as the terminal - only this leaf pops in
+        if (auto goalGeo = localGoal(tree, view))
+            configureToGoal(view, *goalGeo);
+        leaf->geometry().startPopin(0.8f);
+        startAnimationLoop();
+    }
+    
+    // Hide the terminal behind the view that took over its leaf; it keeps a
+    // transformer for the way back
+    void hideSwallowedTerminal(wayfire_toplevel_view terminal, wayfire_toplevel_view view)
+    {
+        wf::scene::set_node_enabled(terminal->get_root_node(), false);
+        ensureTransformer(terminal);
+        auto termData = terminal->get_data_safe<ViewAnimData>();
+        termData->isTiled = false;
+        termData->swallowedBy = view;
+        view->get_data_safe<ViewAnimData>()->swallowedView = terminal;
+    }
+    
+    // Give the leaf of a swallowing view back to its terminal, in place
+    bool restoreSwallowedView(wayfire_toplevel_view view, TileTree* tree)
+    {
+        if (!view->has_data<ViewAnimData>())
+            return false;
+        
+        auto data = view->get_data<ViewAnimData>();
+        auto terminal = data->swallowedView;
+        if (!terminal || !tree->replaceView(view, terminal))
+            return false;
+        
+        wf::scene::set_node_enabled(terminal->get_root_node(), true);
+        auto termData = terminal->get_data_safe<ViewAnimData>();
+        termData->isTiled = true;
+        termData->swallowedBy = nullptr;
+        termData->workspaceIndex = data->workspaceIndex;
+        termData->zone = data->zone;
+        termData->lastScale = -1.0f;
+        
+        if (auto goalGeo = localGoal(tree, terminal))
+            configureToGoal(terminal, *goalGeo);
+        
+        removeTransformer(view);
+        view->erase_data<ViewAnimData>();
+        
+        terminal->damage();
+        startAnimationLoop();
+        return true;
     }
     
     void ensureTransformer(wayfire_toplevel_view view)
@@ -2085,11 +6353,34 @@ class AnimatedTilePlugin : public wf::per_output_plugin_instance_t
         }
     }
     
+    // Every member of a span shows part of the shared trees, so any change
+    // starts all of their loops
     void startAnimationLoop()
     {
+        if (m_span)
+        {
+            migrateSpanViews();
+            m_span->kickAll();
+        }
+        else
+        {
+            startLocalAnimationLoop();
+        }
+    }
+    
+    void startLocalAnimationLoop()
+    {
+        // Another plugin owns the views right now; catch up on resume
+        if (isSuspended())
+        {
+            m_relayoutPending = true;
+            return;
+        }
+        
         if (!m_animationActive)
         {
             m_animationActive = true;
+            m_lastFrameStart.reset();
             output->render->add_effect(&m_animationHook, wf::OUTPUT_EFFECT_PRE);
         }
         output->render->schedule_redraw();
@@ -2112,30 +6403,34 @@ class AnimatedTilePlugin : public wf::per_output_plugin_instance_t
         // Other workspaces' views should not be touched
         int currentWs = getCurrentWorkspaceIndex();
         
+        // Evaluate every channel at the instant this frame will be displayed
+        auto presentTime = predictPresentationTime();
+        
         // Tick all trees to keep animations progressing
-        for (auto& [wsIndex, tree] : m_trees)
+        for (auto& [key, tree] : m_trees)
         {
-            stillAnimating |= tree->tickAnimations();
+            stillAnimating |= tree->tickAnimations(presentTime);
         }
         
         // But only apply geometry to views on the current workspace
-        auto it = m_trees.find(currentWs);
-        if (it != m_trees.end())
+        auto currentTrees = workspaceTrees(currentWs);
+        for (auto tree : currentTrees)
         {
-            for (auto& view : it->second->getViews())
+            // Tiles hidden by monocle get no configures and no damage
+            for (auto& view : viewsShownHere(tree))
             {
-                applyAnimatedGeometry(view, it->second.get());
+                applyAnimatedGeometry(view, tree);
             }
         }
         
         if (!stillAnimating)
         {
             // Animation complete - finalize geometry only for current workspace
-            if (it != m_trees.end())
+            for (auto tree : currentTrees)
             {
-                for (auto& view : it->second->getViews())
+                for (auto& view : viewsShownHere(tree))
                 {
-                    finalizeViewGeometry(view, it->second.get());
+                    finalizeViewGeometry(view, tree);
                 }
             }
             stopAnimationLoop();
@@ -2144,12 +6439,171 @@ class AnimatedTilePlugin : public wf::per_output_plugin_instance_t
         {
             output->render->schedule_redraw();
         }
+        
+        // Borders follow the geometry applied in this same tick
+        refreshBorders();
+        announceLayoutChanges();
+    }
+    
+    // ============================================================================
+    // Output hotplug - trees outlive their output in a core-level registry
+    // ============================================================================
+    
+    // Hand the trees of this output to the core registry (on output removal;
+    // on plugin unload the registry is dropped right after)
+    void parkTrees()
+    {
+        std::map<int, std::shared_ptr<TileTree>> keep;
+        for (auto& [key, tree] : m_trees)
+        {
+            if (!tree->isEmpty())
+            {
+                tree->clearPreselection();
+                keep[key] = std::move(tree);
+            }
+        }
+        m_trees.clear();
+        
+        if (keep.empty())
+            return;
+        
+        auto parked = wf::get_core().get_data_safe<ParkedLayouts>();
+        parked->trees[ParkedLayouts::outputKey(output)] = std::move(keep);
+    }
+    
+    // Re-adopt the trees parked for this output: every surviving window is
+    // pulled back and the whole workspace settles in one layout pass
+    void adoptParkedTrees()
+    {
+        auto parked = wf::get_core().get_data<ParkedLayouts>();
+        if (!parked)
+            return;
+        
+        // The column first, so the trees are laid out around it
+        if (adoptParkedPins(*parked))
+            updateWorkspaceBounds();
+        
+        auto it = parked->trees.find(ParkedLayouts::outputKey(output));
+        if (it == parked->trees.end())
+            return;
+        
+        auto trees = std::move(it->second);
+        parked->trees.erase(it);
+        
+        auto alive = wf::get_core().get_all_views();
+        for (auto& [key, tree] : trees)
+        {
+            // Drop windows that are gone or got tiled elsewhere meanwhile
+            for (auto& view : tree->getViews())
+            {
+                bool exists = std::find(alive.begin(), alive.end(), wayfire_view(view)) != alive.end();
+                if (!exists || !view->is_mapped() || view->has_data<ViewAnimData>())
+                    tree->removeView(view, false);
+            }
+            
+            if (tree->isEmpty())
+                continue;
+            
+            int wsIndex = keyWorkspace(key);
+            auto coords = workspaceCoords(wsIndex);
+            for (auto& view : tree->getViews())
+            {
+                if (view->get_output() != output)
+                    wf::move_view_to_output(view, output, false);
+                output->wset()->move_to_workspace(view, coords);
+                
+                auto data = view->get_data_safe<ViewAnimData>();
+                data->isTiled = true;
+                data->workspaceIndex = wsIndex;
+                data->zone = keyZone(key);
+                ensureTransformer(view);
+            }
+            
+            // Terminals shown again when the tree was parked
+            for (auto& [view, terminal] : tree->takeParkedSwallows())
+            {
+                if (!terminal->is_mapped() || terminal->has_data<ViewAnimData>())
+                    continue;
+                
+                if (terminal->get_output() != output)
+                    wf::move_view_to_output(terminal, output, false);
+                output->wset()->move_to_workspace(terminal, coords);
+                hideSwallowedTerminal(terminal, view);
+            }
+            
+            addTree(key, std::move(tree));
+        }
+        
+        // Parked with more zones than are configured now
+        if (!m_span)
+            rehomeOrphanedZones();
+        
+        updateTreeConfig();
+        for (auto& [wsIndex, tree] : m_trees)
+        {
+            tree->recalculateLayout(true);
+            syncHiddenTiles(tree.get());
+        }
+        
+        if (!m_trees.empty())
+            startAnimationLoop();
+    }
+    
+    // Tell other plugins which workspace layouts changed since last time
+    void announceLayoutChanges()
+    {
+        bool changed = false;
+        for (auto& [key, tree] : m_trees)
+        {
+            auto& layout = tree->publishedLayout();
+            auto& announced = m_announcedGenerations[key];
+            if (announced == layout.generation)
+                continue;
+            
+            announced = layout.generation;
+            changed = true;
+            layout_changed_signal ev{output, workspaceCoords(keyWorkspace(key)),
+                keyZone(key), &layout};
+            output->emit(&ev);
+        }
+        
+        // The preselection area is derived from a tile's goal
+        if (changed)
+            refreshPreselectOverlay();
+    }
+    
+    // Put a view at its goal. A goal of the same size is a pure move, which
+    // needs no configure - pseudotiles only ever take this path on relayout
+    void configureToGoal(wayfire_toplevel_view view, wf::geometry_t goal)
+    {
+        auto current = view->get_geometry();
+        if (current.width == goal.width && current.height == goal.height)
+        {
+            if (current.x != goal.x || current.y != goal.y)
+                view->move(goal.x, goal.y);
+            return;
+        }
+        
+        view->set_geometry(goal);
+        m_configureCount++;
+    }
+    
+    // Scale of this output, used to round animated geometry to physical pixels
+    float getOutputScale() const
+    {
+        return (output && output->handle) ? output->handle->scale : 1.0f;
     }
     
     void applyAnimatedGeometry(wayfire_toplevel_view view, TileTree* tree)
     {
         auto currentGeo = tree->getViewGeometry(view);
-        auto goalGeo = tree->getViewGoalGeometry(view);
+        auto goalGeo = localGoal(tree, view);
+        if (currentGeo)
+        {
+            auto offset = spanOffset();
+            currentGeo->x += offset.x;
+            currentGeo->y += offset.y;
+        }
         auto [animScale, animAlpha] = tree->getViewScaleAlpha(view);
         
         if (!currentGeo || !goalGeo)
@@ -2160,14 +6614,30 @@ class AnimatedTilePlugin : public wf::per_output_plugin_instance_t
         
         auto data = view->get_data_safe<ViewAnimData>();
         
+        // Round the animated rectangle once, to this output's physical pixels
+        GeometryF snapped = snapToPixelGrid(*currentGeo, getOutputScale());
+        
+        // Nothing moved by a whole physical pixel - skip the update and damage
+        if (snapped == data->lastSnappedGeometry &&
+            *goalGeo == data->lastGoalGeometry &&
+            animScale == data->lastScale && animAlpha == data->lastAlpha)
+        {
+            return;
+        }
+        
+        data->lastSnappedGeometry = snapped;
+        data->lastGoalGeometry = *goalGeo;
+        data->lastScale = animScale;
+        data->lastAlpha = animAlpha;
+        
         // Set the view to its goal size/position
-        view->set_geometry(*goalGeo);
+        configureToGoal(view, *goalGeo);
         
         if (data->transformer)
         {
             // Scale factor for position/size animation
-            float scaleX = static_cast<float>(currentGeo->width) / goalGeo->width;
-            float scaleY = static_cast<float>(currentGeo->height) / goalGeo->height;
+            float scaleX = snapped.width / goalGeo->width;
+            float scaleY = snapped.height / goalGeo->height;
             
             scaleX = std::clamp(scaleX, 0.1f, 10.0f);
             scaleY = std::clamp(scaleY, 0.1f, 10.0f);
@@ -2179,8 +6649,8 @@ class AnimatedTilePlugin : public wf::per_output_plugin_instance_t
             // Calculate offset
             float goalCenterX = goalGeo->x + goalGeo->width / 2.0f;
             float goalCenterY = goalGeo->y + goalGeo->height / 2.0f;
-            float currentCenterX = currentGeo->x + currentGeo->width / 2.0f;
-            float currentCenterY = currentGeo->y + currentGeo->height / 2.0f;
+            float currentCenterX = snapped.x + snapped.width / 2.0f;
+            float currentCenterY = snapped.y + snapped.height / 2.0f;
             
             float offsetX = currentCenterX - goalCenterX;
             float offsetY = currentCenterY - goalCenterY;
@@ -2197,11 +6667,11 @@ class AnimatedTilePlugin : public wf::per_output_plugin_instance_t
     
     void finalizeViewGeometry(wayfire_toplevel_view view, TileTree* tree)
     {
-        auto goalGeo = tree->getViewGoalGeometry(view);
+        auto goalGeo = localGoal(tree, view);
         if (!goalGeo)
             return;
         
-        view->set_geometry(*goalGeo);
+        configureToGoal(view, *goalGeo);
         
         auto data = view->get_data_safe<ViewAnimData>();
         if (data->transformer)
@@ -2213,6 +6683,14 @@ class AnimatedTilePlugin : public wf::per_output_plugin_instance_t
             data->transformer->alpha = 1.0f;
         }
         
+        data->lastSnappedGeometry = {
+            static_cast<float>(goalGeo->x), static_cast<float>(goalGeo->y),
+            static_cast<float>(goalGeo->width), static_cast<float>(goalGeo->height)
+        };
+        data->lastGoalGeometry = *goalGeo;
+        data->lastScale = 1.0f;
+        data->lastAlpha = 1.0f;
+        
         // Switch from WINDOW_IN to WINDOW_MOVE after initial animation
         data->currentAnimType = AnimationType::WINDOW_MOVE;
         
@@ -2222,4 +6700,51 @@ class AnimatedTilePlugin : public wf::per_output_plugin_instance_t
 
 } // namespace animated_tile
 
-DECLARE_WAYFIRE_PLUGIN(wf::per_output_plugin_t<animated_tile::AnimatedTilePlugin>);
+namespace animated_tile
+{
+// Parked trees reference this plugin's code, so they cannot outlive it
+class AnimatedTilePluginMain : public wf::per_output_plugin_t<AnimatedTilePlugin>
+{
+  public:
+    void init() override
+    {
+        // Trees handed over by the previous instance (plugin reload) are
+        // parked first, so every output adopts its own in init()
+        ParkedLayouts::restore();
+        per_output_plugin_t::init();
+        ipc_repo->register_method("animated-tile/dump-trace", on_dump_trace);
+    }
+    
+    void fini() override
+    {
+        ipc_repo->unregister_method("animated-tile/dump-trace");
+        per_output_plugin_t::fini();
+        
+        // All trees are parked by now; hand them to the next instance
+        if (auto parked = wf::get_core().get_data<ParkedLayouts>())
+            parked->save();
+        wf::get_core().erase_data<ParkedLayouts>();
+        wf::get_core().erase_data<SpanGroup>();
+    }
+    
+  private:
+    wf::shared_data::ref_ptr_t<wf::ipc::method_repository_t> ipc_repo;
+    
+    // Dump the flight recorder of every output
+    wf::ipc::method_callback on_dump_trace = [this] (auto)
+    {
+        int written = 0;
+        for (auto& [output, instance] : output_instance)
+        {
+            if (!instance->dumpTrace("ipc request").empty())
+                written++;
+        }
+        
+        auto response = wf::ipc::json_ok();
+        response["files"] = written;
+        return response;
+    };
+};
+} // namespace animated_tile
+
+DECLARE_WAYFIRE_PLUGIN(animated_tile::AnimatedTilePluginMain);